@@ -15,31 +15,259 @@
 //  To receive a copy of the GNU General Public License write the Free Software
 //  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
+//  Usage: switchend [-16] [-scalar] [-i file]
+//
+//     -16 ......... swap half words (12 -> 21) instead of words (1234 -> 4321)
+//     -scalar ..... don't use the SSSE3 shuffle even if the CPU has it
+//     -i file ..... convert file in place instead of stdin to stdout
+//
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SSSE3_PATH
+#include <immintrin.h>
+#endif
+
+#define BLOCK_SIZE (1024 * 1024)   // bytes read & written at a time (multiple of 4)
+
+int width = 4;       // bytes per swapped group
+int use_ssse3 = 0;
+
+
+double get_seconds(void) {
+#ifdef _WIN32
+  return (double) clock() / CLOCKS_PER_SEC;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+#endif
+}
+
+
+#ifdef HAVE_SSSE3_PATH
+// 16 bytes per shuffle, built for SSSE3 even when the rest of the program isn't
+__attribute__((target("ssse3")))
+size_t swap_ssse3(unsigned char *p, size_t n) {
+  const __m128i mask = (width == 4)
+    ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+    : _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  size_t i;
+
+  for (i = 0; (i + 16) <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) (p + i));
+    _mm_storeu_si128((__m128i *) (p + i), _mm_shuffle_epi8(v, mask));
+  }
+  return i;
+}
+#endif
+
+
+// Whole groups only; n must be a multiple of width
+void swap_block(unsigned char *p, size_t n) {
+  size_t i = 0;
+  unsigned int w;
+  unsigned short h;
+
+#ifdef HAVE_SSSE3_PATH
+  if (use_ssse3) {
+    i = swap_ssse3(p, n);
+  }
+#endif
+
+  // Whatever is left (or everything) - shifts the compiler turns into bswap/rol
+  if (width == 4) {
+    for (; i < n; i += 4) {
+      memcpy(&w, p + i, 4);
+      w = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+      memcpy(p + i, &w, 4);
+    }
+  } else {
+    for (; i < n; i += 2) {
+      memcpy(&h, p + i, 2);
+      h = (unsigned short) ((h >> 8) | (h << 8));
+      memcpy(p + i, &h, 2);
+    }
+  }
+}
+
+
+// Last few bytes of the file swap among themselves (123 -> 321, not <null>321)
+void swap_tail(unsigned char *p, size_t n) {
+  size_t i;
+  unsigned char t;
+
+  for (i = 0; i < n / 2; i++) {
+    t = p[i];
+    p[i] = p[n - 1 - i];
+    p[n - 1 - i] = t;
+  }
+}
+
+
+void swap_all(unsigned char *p, size_t n) {
+  size_t whole = n - (n % width);
+
+  swap_block(p, whole);
+  swap_tail(p + whole, n - whole);
+}
+
 
-int main(void) {
-  int a[4], i;
-  int done = 0;
-  while(!done) {
-    for (i = 0; i < 4; i++) {
-      a[i] = getchar();
-      if (a[i] == EOF) {
-	a[i] = 0;
-	if (!done) {
-	  done = 1 + i;
-	}       
-      }
+size_t convert_stream(void) {
+  unsigned char *buf;
+  size_t have = 0, got, whole;
+  size_t total = 0;
+
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  buf = malloc(BLOCK_SIZE);
+  if (buf == NULL) {
+    fprintf(stderr, "Could not allocate %d bytes\n", BLOCK_SIZE);
+    exit(1);
+  }
+
+  // Big blocks in and out; a partial group waits for the next read
+  while ((got = fread(buf + have, 1, BLOCK_SIZE - have, stdin)) > 0) {
+    have += got;
+    whole = have - (have % width);
+    swap_block(buf, whole);
+    if (fwrite(buf, 1, whole, stdout) != whole) {
+      fprintf(stderr, "Write failed: %s\n", strerror(errno));
+      exit(1);
     }
-    for (i = 3 ; i >= 0; i--) {
-      if (done) {
-	if ((done - 1) <= i ) {
-	  continue;
-	}
-      }
-      putchar(a[i]);
-    }            
-  }
-  fprintf(stderr, "\nDone\n");
+    memmove(buf, buf + whole, have - whole);
+    have -= whole;
+    total += whole;
+  }
+
+  swap_tail(buf, have);
+  fwrite(buf, 1, have, stdout);
+  fflush(stdout);
+  total += have;
+
+  free(buf);
+  return total;
+}
+
+
+size_t convert_file(char *filename) {
+  unsigned char *buf;
+  size_t size;
+  FILE *fd;
+
+#ifndef _WIN32
+  struct stat st;
+  int handle;
+
+  handle = open(filename, O_RDWR);
+  if (handle < 0) {
+    fprintf(stderr, "Could not open %s: %s\n", filename, strerror(errno));
+    exit(1);
+  }
+  if (fstat(handle, &st) < 0) {
+    fprintf(stderr, "Could not stat %s: %s\n", filename, strerror(errno));
+    exit(1);
+  }
+  size = st.st_size;
+  if (size == 0) {
+    close(handle);
+    return 0;
+  }
+
+  // Swapped straight in the file's pages
+  buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+  if (buf != MAP_FAILED) {
+    close(handle);
+    swap_all(buf, size);
+    munmap(buf, size);
+    return size;
+  }
+  close(handle);
+#endif
+
+  // No mapping - whole file through one buffer
+  fd = fopen(filename, "r+b");
+  if (fd == NULL) {
+    fprintf(stderr, "Could not open %s: %s\n", filename, strerror(errno));
+    exit(1);
+  }
+  fseek(fd, 0, SEEK_END);
+  size = ftell(fd);
+  fseek(fd, 0, SEEK_SET);
+
+  buf = malloc(size + 1);
+  if ((buf == NULL) || (fread(buf, 1, size, fd) != size)) {
+    fprintf(stderr, "Could not read %s\n", filename);
+    exit(1);
+  }
+  swap_all(buf, size);
+  fseek(fd, 0, SEEK_SET);
+  if (fwrite(buf, 1, size, fd) != size) {
+    fprintf(stderr, "Could not write %s: %s\n", filename, strerror(errno));
+    exit(1);
+  }
+  fclose(fd);
+  free(buf);
+  return size;
+}
+
+
+int main(int argc, char **argv) {
+  char *filename = NULL;
+  int allow_simd = 1;
+  size_t total;
+  double start, elapsed;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-16") == 0) {
+      width = 2;
+    } else if (strcmp(argv[i], "-scalar") == 0) {
+      allow_simd = 0;
+    } else if ((strcmp(argv[i], "-i") == 0) && ((i + 1) < argc)) {
+      filename = argv[++i];
+    } else {
+      fprintf(stderr, "Usage: switchend [-16] [-scalar] [-i file]  (else stdin to stdout)\n");
+      return 1;
+    }
+  }
+
+#ifdef HAVE_SSSE3_PATH
+  __builtin_cpu_init();
+  use_ssse3 = allow_simd && __builtin_cpu_supports("ssse3");
+#endif
+
+  start = get_seconds();
+  if (filename) {
+    total = convert_file(filename);
+  } else {
+    total = convert_stream();
+  }
+  elapsed = get_seconds() - start;
+
+  fprintf(stderr, "\nDone  (%lu bytes, %d bit swap, %s, %.3f seconds", (unsigned long) total, width * 8,
+          use_ssse3 ? "SSSE3" : "scalar", elapsed);
+  if (elapsed > 0) {
+    fprintf(stderr, " = %.1f MB/s", (total / 1048576.0) / elapsed);
+  }
+  fprintf(stderr, ")\n");
   return 0;
 }
@@ -5,6 +5,84 @@
 //  Note:
 //  This program is for De-Bricking the WRT54G/GS and other misc routers.
 //
+//  New for v4.9 - Flash status polling with PrAcc routines loops inside one
+//                 debug module (register setup once per wait); with
+//                 /ramaddr the loop runs from target RAM instead, without
+//                 it every poll still fetches ~6 instructions through PrAcc
+//               - Added "-load:<file>" to run raw or ELF images from RAM
+//                     - /loadaddr:XXXXXXXX . RAM address for raw images
+//                     - /entry:XXXXXXXX .... start address after loading
+//               - Added "-dump" to save any memory range without probing flash
+//               - Added "-bwtest" to report throughput of each access mode
+//               - Added AMD Unlock Bypass programming for chips that have it
+//                     - /nobypass .......... prevent Unlock Bypass programming
+//               - Added Write Buffer programming (Intel 28FxxxJ3, AMD MirrorBit)
+//                     - /nobuffer .......... prevent Write Buffer programming
+//               - Added Differential Flashing (skips unchanged blocks and only
+//                 erases blocks that need a bit set back to 1)
+//                     - /diff .............. only erase/program changed blocks
+//               - Erasing a whole flash uses Chip Erase (AMD/SST) or a single
+//                 unlock pass then erase (Intel) with timed progress reports
+//                     - /nochiperase ....... prevent Chip Erase
+//               - Added Multi-Sector Erase for AMD parts using a small helper
+//                 run from target RAM (queues sectors inside the 50us window)
+//                     - /ramaddr:XXXXXXXX .. scratch RAM for on-target helpers
+//               - Added typical/max program and erase times to the flash chip
+//                 table; with a slow link the per-word poll is skipped and
+//                 each block is verified and patched up instead
+//                     - /timing ............ enable the timing model
+//               - The image is analysed before flashing: 0xFFFF half words and
+//                 blank blocks are not programmed, blocks blank in the image
+//                 and already blank on flash are not erased, and the progress
+//                 percentage counts the bytes really programmed
+//               - Added CFI query support - command set, geometry, write buffer
+//                 and timings come from the chip; flash_chip_list is only needed
+//                 as an override or for parts without CFI
+//               - Block map is now a list of flash regions searched in log time;
+//                 no limit on the number of blocks, 32MB parts supported and
+//                 flash beyond the CPU window reached through a bank register
+//                     - /bankreg:XXXXXXXX .. register selecting the flash bank
+//               - Flash command sets are now drivers (flash_driver_list) with
+//                 program loops built per access mode & endianness
+//               - Each flashed block is read back right away; bad words are
+//                 programmed again, then the block is erased and retried
+//                     - /noverify .......... skip the verify pass
+//               - Added serial (SPI) flash behind the Broadcom chipcommon
+//                 controller (BCM5354 and later) - page program & sector erase
+//                     - /nospi ............. skip the serial flash check
+//               - Dual bank (read-while-write) parts erase one bank while
+//                 programming the other
+//                     - /nodualbank ........ erase everything up front instead
+//               - Interleaved x32 bus mode - both chips of a side by side
+//                 x16 pair take each command & program in one 32 bit write
+//                     - /x32 ............... two x16 chips on a 32 bit bus
+//               - Progress drawn at a fixed rate, hex dumps written in
+//                 large blocks instead of a word at a time
+//                     - /progress:FILE ..... machine readable progress stream
+//               - Image files memory mapped (backups pre-sized, flash images
+//                 read-only), endian swaps done in one pass over the buffer
+//               - Cable thread hands dumps, progress & file swaps to a
+//                 console thread through a lock-free ring (POSIX builds)
+//                     - /nothreads ......... keep everything on one thread
+//               - Scan vectors expanded to parallel port pin states by table
+//                 lookup (8 bits at a time, SSE2 where built in) and TDO packed
+//                 back 16 samples at a time instead of bit by bit
+//                     - "-benchscan" ....... time it against the per bit loop
+//               - Backups and flashes keep a journal (<file>.journal) of the
+//                 blocks erased, programmed and saved, synced once a second
+//                     - /resume ............ carry on from where it stopped
+//               - Sparse backups - chip & block map header, a hash per block,
+//                 only non-blank blocks stored (PackBits), any block readable
+//                 on its own; the hashes stand in for the flash under /diff
+//                     - /sparse ............ write <file>.SAVED_<time>.SPARSE
+//                     - /basis:FILE ........ /diff against a sparse backup
+//                     - "-export:<file>" ... write the raw backup it stands for
+//               - ELF, Intel HEX, S-record and TRX images are parsed into
+//                 segments; only blocks they touch are erased & programmed and
+//                 bytes they leave out of those blocks are kept
+//                     - /image:FILE ........ flash the area from FILE
+//                     - /offsets ........... HEX & S-record addresses count from the area
+//
 //  New for cshore2 - Added 1 new Flash Chip Parts to the list:
 //                     - MX29LV640MB 4Mx16 BotB    (8MB)
 //                  - Fixed bug in wiggler cable support
@@ -131,6 +209,11 @@
 //              -flash:wholeflash
 //              -flash:custom
 //              -probeonly
+//              -load:<file>
+//              -dump
+//              -bwtest
+//              -benchscan
+//              -export:<file>
 //
 //              Optional Switches
 //              -----------------
@@ -140,6 +223,24 @@
 //              /nobreak ........... prevent Issuing Debug Mode JTAGBRK
 //              /noerase ........... prevent Forced Erase before Flashing
 //              /notimestamp ....... prevent Timestamping of Backups
+//              /nobypass .......... prevent AMD Unlock Bypass Programming
+//              /nobuffer .......... prevent Write Buffer Programming
+//              /diff .............. only erase/program blocks that changed
+//              /nochiperase ....... prevent Chip Erase of a whole flash
+//              /ramaddr:XXXXXXXX .. scratch RAM for on-target helpers (in HEX)
+//              /timing ............ use chip timings to skip per-word polls
+//              /noverify .......... prevent reading back each flashed block
+//              /nospi ............. prevent looking for chipcommon serial flash
+//              /nodualbank ........ prevent erasing one bank while programming the other
+//              /x32 ............... flash is two x16 chips side by side (AMD only)
+//              /progress:FILE ..... machine readable progress lines to FILE (- = stderr)
+//              /nothreads ......... prevent formatting progress on a separate thread
+//              /resume ............ carry on an interrupted backup or flash from its journal
+//              /sparse ............ backup only non-blank blocks, packed, with block hashes
+//              /basis:FILE ........ /diff against a sparse backup instead of reading flash
+//              /image:FILE ........ -flash from FILE (raw, ELF, Intel HEX, S-record or TRX)
+//              /offsets ........... Intel HEX / S-record addresses are offsets into the area
+//              /bankreg:XXXXXXXX .. register selecting the 32MB flash bank (in HEX)
 //              /dma ............... force use of DMA routines
 //              /nodma ............. force use of PRACC routines (No DMA)
 //              /start:XXXXXXXX .... custom start location (in HEX)
@@ -150,6 +251,8 @@
 //              /wiggler ........... use wiggler cable
 //              /bigendian.......... device CPU is bigendian
 //              /bigendianfile...... rw big endian image files
+//              /loadaddr:XXXXXXXX . RAM address for -load of a raw image (in HEX)
+//              /entry:XXXXXXXX .... start address after -load (in HEX)
 //              /fc:XX = Optional (Manual) Flash Chip Selection
 //
 // **************************************************************************
@@ -198,8 +301,15 @@ int issue_reset      = 1;
 int issue_enable_mw  = 1;
 int issue_watchdog   = 1;
 int issue_break      = 1;
+int debug_mode       = 0;   // BRKST seen - PrAcc modules can be run
 int issue_erase      = 1;
 int issue_timestamp  = 1;
+int issue_bypass     = 1;
+int issue_buffer     = 1;
+int diff_mode        = 0;
+int issue_chiperase  = 1;
+unsigned int ram_helper_addr  = 0;
+unsigned int* ram_helper_loaded = NULL;
 int force_dma        = 0;
 int force_nodma      = 0;
 int selected_fc      = 0;
@@ -213,6 +323,11 @@ int instrlen         = 0;
 int wiggler          = 0;
 int bigendian        = 0;
 int bigendianfile    = 0;
+unsigned int selected_load    = 0;
+unsigned int selected_entry   = 0;
+int loadaddr_given   = 0;
+int entry_given      = 0;
+char            image_file[128];
 
 
 char            flash_part[128];
@@ -220,8 +335,59 @@ unsigned int    flash_size = 0;
 
 int             block_total = 0;
 unsigned int    block_addr = 0;
-unsigned int    blocks[1024];
+unsigned int    flash_map_end = 0;
+unsigned int    flash_window_size = FLASH_WINDOW_SIZE;
+unsigned int    bank_register = 0;
+int             bank_current = -1;
 unsigned int    cmd_type = 0;
+unsigned int    flash_flags = 0;
+unsigned int    flash_buffer_size = 0;
+unsigned int    flash_prog_typ = 0;
+unsigned int    flash_prog_max = 0;
+unsigned int    flash_erase_typ = 0;
+unsigned int    flash_erase_max = 0;
+
+int             issue_timing = 0;
+int             issue_verify = 1;
+int             verify_ok, verify_repaired, verify_failed;
+int             skip_word_poll = 0;
+int             pending_poll = 0;
+unsigned int    pending_poll_addr;
+unsigned int    pending_poll_data;
+double          link_latency_us = 0;
+
+unsigned int    progress_done  = 0;
+unsigned int    progress_total = 0;
+int             progress_by_work = 0;
+char            progress_text[PROGRESS_TEXT_SIZE];   // Hex dump waiting for the next render
+unsigned int    progress_text_len = 0;
+double          progress_last = 0;                   // When the progress was last rendered
+double          progress_started = 0;
+unsigned int    progress_addr = 0;
+char*           progress_action = "";
+char*           progress_cable_action = "";          // Cable side copy - progress_action is the console's
+FILE*           progress_stream = NULL;              // /progress: machine readable updates
+int             progress_swap = 0;                   // Console side swaps dumped words for the file
+int             progress_live = 0;                   // Records seen since the last flush
+int             progress_threaded = 0;               // Console work runs on its own thread
+int             issue_threads = 1;
+unsigned char   scan_tdi_table[256][16];             // TDI byte -> pin states, TCK low & high per bit
+unsigned char   scan_tms_table[256][16];             // TMS byte -> bits it adds to those states
+int             scan_tdo_bit = TDO;                  // Status bit carrying TDO
+int             scan_tdo_invert = 0;                 // Wiggler TDO arrives on the inverted BUSY line
+int             scan_simd = 1;                       // SSE2 kernels when built in
+FILE*           journal_fd = NULL;                   // <file>.journal of the running operation
+char            journal_name[160];
+char            journal_file[128];                   // File named in the header of a resumed journal
+double          journal_synced = 0;                  // When the journal last went to disk
+unsigned char*  journal_state = NULL;                // Per block JOURNAL_* replayed by /resume
+unsigned int    journal_resume_addr = 0;             // Backup: everything below this is saved
+int             journal_done_blocks = 0;             // Blocks a resume must not erase again
+int             issue_resume = 0;
+int             backup_sparse = 0;                   // /sparse: packed backup with per block hashes
+char            basis_file[128] = "";                // /basis: sparse backup standing in for the flash
+unsigned char*  erase_skip = NULL;
+int             unlock_bypass = 0;
 
 char            AREA_NAME[128];
 unsigned int    AREA_START;
@@ -232,8 +398,27 @@ unsigned int    devid;
 
 unsigned int    data_register;
 unsigned int    address_register;
+unsigned int    mask_register;
+unsigned int    value_register;
+unsigned int*   fifo_buffer;
+unsigned int    fifo_index;
+unsigned int    fifo_count = 0;         // Words the running block module may move
+
+unsigned int    cpu_chip_id = 0;
+unsigned int    cc_revision = 0;
+int             issue_spi = 1;
+int             issue_dualbank = 1;
+int             flash_x32 = 0;          // Two x16 chips side by side on a 32 bit bus
+unsigned int    dual_bank_split = 0;    // First address of the second bank (0 = single bank part)
+int             bg_erase_block = 0;     // Block erasing behind programming (0 = none)
+int             bg_erase_next = 0;
+int             bg_erase_last = 0;
+int             bg_erase_failed = 0;
+int             bg_erase_held = 0;      // Background erase suspended for programming
+double          bg_erase_seconds = 0;
 
 int USE_DMA       = 0;
+int DMA_SUPPORTED = 0;
 int ejtag_version = 0;
 
 
@@ -250,6 +435,7 @@ processor_chip_type  processor_chip_list[] = {
    { 0x2471217F, 8, "Broadcom BCM4712 Rev 2 CPU" },
    { 0x0535017F, 8, "Broadcom BCM5350 Rev 1 CPU" },
    { 0x0535217F, 8, "Broadcom BCM5352 Rev 1 CPU" },
+   { 0x0535417F, 8, "Broadcom BCM5354 Rev 1 CPU" },         // Serial (SPI) flash behind chipcommon
    { 0x0536517F, 8, "Broadcom BCM5365 Rev 1 CPU" },         // BCM5365 Not Completely Verified Yet
    { 0x0634817F, 5, "Broadcom BCM6348 Rev 1 CPU" },         // is bigendian  
    { 0x0634517F, 5, "Broadcom BCM6345 Rev 1 CPU" },         // BCM6345 Not Completely Verified Yet
@@ -260,6 +446,84 @@ processor_chip_type  processor_chip_list[] = {
    };
 
 
+typedef struct _image_file_type {
+    unsigned char*      data;           // Whole File In Memory (mapped or read)
+    unsigned int        length;
+    int                 mapped;         // Else data was malloc'd
+    int                 writable;       // Written back to name on close
+    char*               name;
+} image_file_type;
+
+
+typedef struct _progress_record_type {
+    int                 kind;           // PROGRESS_*
+    char*               action;
+    unsigned int        addr;
+    unsigned int        end;            // PROGRESS_SKIP: end of the blank run
+    unsigned int*       data;           // PROGRESS_DUMP: words (must stay put until flushed)
+    unsigned int        count;          // Words, or bytes for PROGRESS_SKIP / PROGRESS_ADVANCE
+} progress_record_type;
+
+// Single Producer (cable thread) / Single Consumer (console thread) Ring
+progress_record_type  progress_ring[PROGRESS_RING_SIZE];
+unsigned int          progress_head = 0;     // Only the cable thread writes this
+unsigned int          progress_tail = 0;     // Only the console thread writes this
+
+
+// Sparse Backup - Header, Then One Entry Per Block, Then The Packed Blocks
+typedef struct _sparse_header_type {
+    char                magic[8];       // SPARSE_MAGIC
+    unsigned int        version;
+    unsigned int        vendid;         // Flash chip the backup came from
+    unsigned int        devid;
+    unsigned int        window;         // Flash window base
+    unsigned int        flash_size;
+    unsigned int        start;          // Area saved
+    unsigned int        length;
+    unsigned int        block_count;    // Entries in the block table
+    unsigned int        flags;          // SPARSE_SWAPPED
+    char                part[64];
+} sparse_header_type;
+
+typedef struct _sparse_block_type {
+    unsigned int        addr;
+    unsigned int        size;           // Bytes of the area in this block
+    unsigned int        hash;           // image_hash() of the words as the CPU reads them
+    unsigned int        offset;         // File offset of the data, 0 = blank (all 0xFF)
+    unsigned int        stored;         // Bytes in the file (== size means not packed)
+} sparse_block_type;
+
+// Parsed Image (ELF, Intel HEX, S-record, TRX) - Runs Of Bytes The File Gave
+typedef struct _image_segment_type {
+    unsigned int        addr;           // Flash address
+    unsigned int        length;         // Bytes
+} image_segment_type;
+
+image_segment_type*   image_segments = NULL; // In address order once parsing is done
+int                   image_segment_count = 0;
+int                   image_segment_max = 0;
+unsigned char*        image_area_data = NULL; // Area buffer the parser fills in
+unsigned int          image_area_start = 0;
+unsigned int          image_area_length = 0;
+unsigned int          image_outside = 0;     // Bytes given for addresses outside the area
+int                   image_offsets = 0;     // /offsets: HEX & S-record addresses are offsets into the area
+
+sparse_header_type    sparse_header;
+sparse_block_type*    sparse_blocks = NULL;
+FILE*                 sparse_fd = NULL;      // Open for random block reads
+
+
+typedef struct _flash_region_type {
+    unsigned int        start;          // Address of the first block
+    unsigned int        block_size;     // Block size in Bytes
+    unsigned int        block_count;    // Blocks in this region
+    int                 first_block;    // Block number of the first block
+} flash_region_type;
+
+flash_region_type  flash_regions[MAX_FLASH_REGIONS];
+int                region_total = 0;
+
+
 typedef struct _flash_area_type {
     unsigned int        chip_size;
     char*               area_name;
@@ -277,48 +541,56 @@ flash_area_type  flash_area_list[] = {
    { size4MB,    "CFE",         0x1FC00000,  0x40000 },
    { size8MB,    "CFE",         0x1C000000,  0x40000 },
    { size16MB,   "CFE",         0x1C000000,  0x40000 },
+   { size32MB,   "CFE",         0x1C000000,  0x40000 },
 
    { size1MB,    "CFE64",         0x1FC00000,  0x10000 },
    { size2MB,    "CFE64",         0x1FC00000,  0x10000 },
    { size4MB,    "CFE64",         0x1FC00000,  0x10000 },
    { size8MB,    "CFE64",         0x1C000000,  0x10000 },
    { size16MB,   "CFE64",         0x1C000000,  0x10000 },
+   { size32MB,   "CFE64",         0x1C000000,  0x10000 },
 
    { size1MB,    "CFE128",         0x1FC00000,  0x20000 },
    { size2MB,    "CFE128",         0x1FC00000,  0x20000 },
    { size4MB,    "CFE128",         0x1FC00000,  0x20000 },
    { size8MB,    "CFE128",         0x1C000000,  0x20000 },
    { size16MB,   "CFE128",         0x1C000000,  0x20000 },
+   { size32MB,   "CFE128",         0x1C000000,  0x20000 },
 
    { size1MB,    "KERNEL",      0x1FC40000,  0xB0000  },
    { size2MB,    "KERNEL",      0x1FC40000,  0x1B0000 },
    { size4MB,    "KERNEL",      0x1FC40000,  0x3B0000 },
    { size8MB,    "KERNEL",      0x1C040000,  0x7A0000 },
    { size16MB,   "KERNEL",      0x1C040000,  0x7A0000 },
+   { size32MB,   "KERNEL",      0x1C040000,  0x7A0000 },
 
    { size1MB,    "KERNEL64",      0x1FC10000,  0xE0000  },
    { size2MB,    "KERNEL64",      0x1FC10000,  0x1E0000 },
    { size4MB,    "KERNEL64",      0x1FC10000,  0x3E0000 },
    { size8MB,    "KERNEL64",      0x1C010000,  0x7D0000 },
    { size16MB,   "KERNEL64",      0x1C010000,  0x7D0000 },
+   { size32MB,   "KERNEL64",      0x1C010000,  0x7D0000 },
 
    { size1MB,    "KERNEL128",      0x1FC20000,  0xD0000  },
    { size2MB,    "KERNEL128",      0x1FC20000,  0x1D0000 },
    { size4MB,    "KERNEL128",      0x1FC20000,  0x3D0000 },
    { size8MB,    "KERNEL128",      0x1C020000,  0x7C0000 },
    { size16MB,   "KERNEL128",      0x1C020000,  0x7C0000 },
+   { size32MB,   "KERNEL128",      0x1C020000,  0x7C0000 },
 
    { size1MB,    "NVRAM",       0x1FCF0000,  0x10000 },
    { size2MB,    "NVRAM",       0x1FDF0000,  0x10000 },
    { size4MB,    "NVRAM",       0x1FFF0000,  0x10000 },
    { size8MB,    "NVRAM",       0x1C7E0000,  0x20000 },
    { size16MB,   "NVRAM",       0x1C7E0000,  0x20000 },
+   { size32MB,   "NVRAM",       0x1C7E0000,  0x20000 },
 
    { size1MB,    "WHOLEFLASH",  0x1FC00000,  0x100000 },
    { size2MB,    "WHOLEFLASH",  0x1FC00000,  0x200000 },
    { size4MB,    "WHOLEFLASH",  0x1FC00000,  0x400000 },
    { size8MB,    "WHOLEFLASH",  0x1C000000,  0x800000 },
-   { size16MB,   "WHOLEFLASH",  0x1C000000,  0x800000 },
+   { size16MB,   "WHOLEFLASH",  0x1C000000,  0x1000000 },
+   { size32MB,   "WHOLEFLASH",  0x1C000000,  0x2000000 },
 
    { 0, 0, 0, 0 }
    };
@@ -338,90 +610,148 @@ typedef struct _flash_chip_type {
     unsigned int        region3_size;   // Region 3 block size
     unsigned int        region4_num;    // Region 4 block count
     unsigned int        region4_size;   // Region 4 block size
+    unsigned int        flags;          // Optional Device Features (FLAG_*)
+    unsigned int        buffer_size;    // Write Buffer size in Bytes (0 = none)
+    unsigned int        prog_typ;       // Word Program time, typical (us)
+    unsigned int        prog_max;       // Word Program time, maximum (us)
+    unsigned int        erase_typ;      // Block Erase time, typical (ms)
+    unsigned int        erase_max;      // Block Erase time, maximum (ms)
 } flash_chip_type;
 
 
+typedef struct _cfi_info_type {
+    unsigned int        cmd_set;        // Primary Command Set (CFI 0x13)
+    unsigned int        flash_size;     // Total size in Bytes
+    unsigned int        buffer_size;    // Write Buffer size in Bytes (0 = none)
+    unsigned int        prog_typ;       // Word Program time, typical (us)
+    unsigned int        prog_max;       // Word Program time, maximum (us)
+    unsigned int        erase_typ;      // Block Erase time, typical (ms)
+    unsigned int        erase_max;      // Block Erase time, maximum (ms)
+    int                 regions;        // Erase Region count
+    unsigned int        region_num[MAX_CFI_REGIONS];
+    unsigned int        region_size[MAX_CFI_REGIONS];
+} cfi_info_type;
+
+cfi_info_type    cfi_info;
+int              cfi_byte_swap = 0;
+
+
+typedef void (*program_loop_type)(unsigned int addr, unsigned int *data, unsigned int count);
+
+typedef struct _flash_driver_type {
+    unsigned int        cmd_type;       // Device CMD TYPE handled
+    unsigned int        cfi_cmd_set;    // CFI Primary Command Set id
+    char*               name;           // Command Set Description
+    int                 status_reads;   // Reads return status until reset
+    void                (*read_ids)(void);
+    void                (*reset)(void);
+    void                (*poll)(unsigned int addr, unsigned int data);
+    void                (*erase_block)(unsigned int addr);
+    void                (*erase_start)(unsigned int addr);      // Erase left running (read-while-write parts)
+    void                (*erase_suspend)(unsigned int addr, int suspend);
+    int                 (*erase_busy)(unsigned int addr);       // Erase left running still going
+    void                (*erase_chip)(double start_seconds);
+    void                (*write_buffer)(unsigned int addr, unsigned int *data, unsigned int count);
+    void                (*unlock_bypass)(int enable);
+    program_loop_type   program[2][2];  // Program loops [USE_DMA][bigendian]
+} flash_driver_type;
+
+flash_driver_type*  flash_driver = NULL;
+extern flash_driver_type  flash_driver_list[];   // Defined with the drivers
+extern flash_driver_type  amd_bypass_driver;
+extern flash_driver_type  amd_x32_driver;
+extern flash_driver_type  amd_x32_bypass_driver;
+
+
 flash_chip_type  flash_chip_list[] = {
-   { 0x0001, 0x2249, size2MB, CMD_TYPE_AMD, "AMD 29lv160DB 1Mx16 BotB   (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K },
-   { 0x0001, 0x22c4, size2MB, CMD_TYPE_AMD, "AMD 29lv160DT 1Mx16 TopB   (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K  },
-   { 0x0001, 0x22f9, size4MB, CMD_TYPE_AMD, "AMD 29lv320DB 2Mx16 BotB   (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x0001, 0x22f6, size4MB, CMD_TYPE_AMD, "AMD 29lv320DT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x0001, 0x2200, size4MB, CMD_TYPE_AMD, "AMD 29lv320MB 2Mx16 BotB   (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x0001, 0x227E, size4MB, CMD_TYPE_AMD, "AMD 29lv320MT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x0001, 0x2201, size4MB, CMD_TYPE_AMD, "AMD 29lv320MT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x0089, 0x0018,size16MB, CMD_TYPE_SCS, "Intel 28F128J3 8Mx16       (16MB)"  ,128,size128K, 0,0,          0,0,        0,0        },
-   { 0x0089, 0x8891, size2MB, CMD_TYPE_BSC, "Intel 28F160B3 1Mx16 BotB  (2MB)"   ,8,size8K,     31,size64K,   0,0,        0,0        },
-   { 0x0089, 0x8890, size2MB, CMD_TYPE_BSC, "Intel 28F160B3 1Mx16 TopB  (2MB)"   ,31,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x0089, 0x88C3, size2MB, CMD_TYPE_BSC, "Intel 28F160C3 1Mx16 BotB  (2MB)"   ,8,size8K,     31,size64K,   0,0,        0,0        },
-   { 0x0089, 0x88C2, size2MB, CMD_TYPE_BSC, "Intel 28F160C3 1Mx16 TopB  (2MB)"   ,31,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x00b0, 0x00d0, size2MB, CMD_TYPE_SCS, "Intel 28F160S3/5 1Mx16     (2MB)"   ,32,size64K,   0,0,          0,0,        0,0        },
-   { 0x0089, 0x8897, size4MB, CMD_TYPE_BSC, "Intel 28F320B3 2Mx16 BotB  (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x0089, 0x8896, size4MB, CMD_TYPE_BSC, "Intel 28F320B3 2Mx16 TopB  (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x0089, 0x88C5, size4MB, CMD_TYPE_BSC, "Intel 28F320C3 2Mx16 BotB  (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x0089, 0x88C4, size4MB, CMD_TYPE_BSC, "Intel 28F320C3 2Mx16 TopB  (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x0089, 0x0016, size4MB, CMD_TYPE_SCS, "Intel 28F320J3 2Mx16       (4MB)"   ,32,size128K,  0,0,          0,0,        0,0        },
-   { 0x0089, 0x0014, size4MB, CMD_TYPE_SCS, "Intel 28F320J5 2Mx16       (4MB)"   ,32,size128K,  0,0,          0,0,        0,0        },
-   { 0x00b0, 0x00d4, size4MB, CMD_TYPE_SCS, "Intel 28F320S3/5 2Mx16     (4MB)"   ,64,size64K,   0,0,          0,0,        0,0        },
-   { 0x0089, 0x8899, size8MB, CMD_TYPE_BSC, "Intel 28F640B3 4Mx16 BotB  (8MB)"   ,8,size8K,     127,size64K,  0,0,        0,0        },
-   { 0x0089, 0x8898, size8MB, CMD_TYPE_BSC, "Intel 28F640B3 4Mx16 TopB  (8MB)"   ,127,size64K,  8,size8K,     0,0,        0,0        },
-   { 0x0089, 0x88CD, size8MB, CMD_TYPE_BSC, "Intel 28F640C3 4Mx16 BotB  (8MB)"   ,8,size8K,     127,size64K,  0,0,        0,0        },
-   { 0x0089, 0x88CC, size8MB, CMD_TYPE_BSC, "Intel 28F640C3 4Mx16 TopB  (8MB)"   ,127,size64K,  8,size8K,     0,0,        0,0        },
-   { 0x0089, 0x0017, size8MB, CMD_TYPE_SCS, "Intel 28F640J3 4Mx16       (8MB)"   ,64,size128K,  0,0,          0,0,        0,0        },
-   { 0x0089, 0x0015, size8MB, CMD_TYPE_SCS, "Intel 28F640J5 4Mx16       (8MB)"   ,64,size128K,  0,0,          0,0,        0,0        },
-   { 0x0004, 0x22F9, size4MB, CMD_TYPE_AMD, "MBM29LV320BE 2Mx16 BotB    (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K },
-   { 0x0004, 0x22F6, size4MB, CMD_TYPE_AMD, "MBM29LV320TE 2Mx16 TopB    (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K  },
+   { 0x0001, 0x2249, size2MB, CMD_TYPE_AMD, "AMD 29lv160DB 1Mx16 BotB   (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K  ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0001, 0x22c4, size2MB, CMD_TYPE_AMD, "AMD 29lv160DT 1Mx16 TopB   (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K   ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0001, 0x22f9, size4MB, CMD_TYPE_AMD, "AMD 29lv320DB 2Mx16 BotB   (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0001, 0x22f6, size4MB, CMD_TYPE_AMD, "AMD 29lv320DT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0001, 0x2200, size4MB, CMD_TYPE_AMD, "AMD 29lv320MB 2Mx16 BotB   (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,32 ,11 ,300,700 ,15000 },
+   { 0x0001, 0x227E, size4MB, CMD_TYPE_AMD, "AMD 29lv320MT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,32 ,11 ,300,700 ,15000 },
+   { 0x0001, 0x2201, size4MB, CMD_TYPE_AMD, "AMD 29lv320MT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,32 ,11 ,300,700 ,15000 },
+   { 0x0089, 0x0018,size16MB, CMD_TYPE_SCS, "Intel 28F128J3 8Mx16       (16MB)"  ,128,size128K, 0,0,          0,0,        0,0         ,0                  ,32 ,210,630,1000,5000  },
+   { 0x0089, 0x8891, size2MB, CMD_TYPE_BSC, "Intel 28F160B3 1Mx16 BotB  (2MB)"   ,8,size8K,     31,size64K,   0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x8890, size2MB, CMD_TYPE_BSC, "Intel 28F160B3 1Mx16 TopB  (2MB)"   ,31,size64K,   8,size8K,     0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x88C3, size2MB, CMD_TYPE_BSC, "Intel 28F160C3 1Mx16 BotB  (2MB)"   ,8,size8K,     31,size64K,   0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x88C2, size2MB, CMD_TYPE_BSC, "Intel 28F160C3 1Mx16 TopB  (2MB)"   ,31,size64K,   8,size8K,     0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x00b0, 0x00d0, size2MB, CMD_TYPE_SCS, "Intel 28F160S3/5 1Mx16     (2MB)"   ,32,size64K,   0,0,          0,0,        0,0         ,0                  ,0 ,210,630,1000,5000  },
+   { 0x0089, 0x8897, size4MB, CMD_TYPE_BSC, "Intel 28F320B3 2Mx16 BotB  (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x8896, size4MB, CMD_TYPE_BSC, "Intel 28F320B3 2Mx16 TopB  (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x88C5, size4MB, CMD_TYPE_BSC, "Intel 28F320C3 2Mx16 BotB  (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x88C4, size4MB, CMD_TYPE_BSC, "Intel 28F320C3 2Mx16 TopB  (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x0016, size4MB, CMD_TYPE_SCS, "Intel 28F320J3 2Mx16       (4MB)"   ,32,size128K,  0,0,          0,0,        0,0         ,0                  ,32 ,210,630,1000,5000  },
+   { 0x0089, 0x0014, size4MB, CMD_TYPE_SCS, "Intel 28F320J5 2Mx16       (4MB)"   ,32,size128K,  0,0,          0,0,        0,0         ,0                  ,0 ,210,630,1000,5000  },
+   { 0x00b0, 0x00d4, size4MB, CMD_TYPE_SCS, "Intel 28F320S3/5 2Mx16     (4MB)"   ,64,size64K,   0,0,          0,0,        0,0         ,0                  ,0 ,210,630,1000,5000  },
+   { 0x0089, 0x8899, size8MB, CMD_TYPE_BSC, "Intel 28F640B3 4Mx16 BotB  (8MB)"   ,8,size8K,     127,size64K,  0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x8898, size8MB, CMD_TYPE_BSC, "Intel 28F640B3 4Mx16 TopB  (8MB)"   ,127,size64K,  8,size8K,     0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x88CD, size8MB, CMD_TYPE_BSC, "Intel 28F640C3 4Mx16 BotB  (8MB)"   ,8,size8K,     127,size64K,  0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x88CC, size8MB, CMD_TYPE_BSC, "Intel 28F640C3 4Mx16 TopB  (8MB)"   ,127,size64K,  8,size8K,     0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0089, 0x0017, size8MB, CMD_TYPE_SCS, "Intel 28F640J3 4Mx16       (8MB)"   ,64,size128K,  0,0,          0,0,        0,0         ,0                  ,32 ,210,630,1000,5000  },
+   { 0x0089, 0x0015, size8MB, CMD_TYPE_SCS, "Intel 28F640J5 4Mx16       (8MB)"   ,64,size128K,  0,0,          0,0,        0,0         ,0                  ,0 ,210,630,1000,5000  },
+   { 0x0004, 0x22F9, size4MB, CMD_TYPE_AMD, "MBM29LV320BE 2Mx16 BotB    (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K  ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0004, 0x22F6, size4MB, CMD_TYPE_AMD, "MBM29LV320TE 2Mx16 TopB    (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K   ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
    // --- These definitions were defined based off the flash.h in GPL source from Linksys, but appear incorrect ---
    //   { 0x00C2, 0x22A8, size4MB, CMD_TYPE_AMD, "MX29LV320B 2Mx16 BotB      (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K },
    //   { 0x00C2, 0x00A8, size4MB, CMD_TYPE_AMD, "MX29LV320B 2Mx16 BotB      (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K },
    //   { 0x00C2, 0x00A7, size4MB, CMD_TYPE_AMD, "MX29LV320T 2Mx16 TopB      (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K  },
    //   { 0x00C2, 0x22A7, size4MB, CMD_TYPE_AMD, "MX29LV320T 2Mx16 TopB      (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K  },
    // --- These below are proper however ---
-   { 0x00C2, 0x22A8, size4MB, CMD_TYPE_AMD, "MX29LV320B 2Mx16 BotB      (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x00C2, 0x00A8, size4MB, CMD_TYPE_AMD, "MX29LV320B 2Mx16 BotB      (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x00C2, 0x00A7, size4MB, CMD_TYPE_AMD, "MX29LV320T 2Mx16 TopB      (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x00C2, 0x22A7, size4MB, CMD_TYPE_AMD, "MX29LV320T 2Mx16 TopB      (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
+   { 0x00C2, 0x22A8, size4MB, CMD_TYPE_AMD, "MX29LV320B 2Mx16 BotB      (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00C2, 0x00A8, size4MB, CMD_TYPE_AMD, "MX29LV320B 2Mx16 BotB      (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00C2, 0x00A7, size4MB, CMD_TYPE_AMD, "MX29LV320T 2Mx16 TopB      (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00C2, 0x22A7, size4MB, CMD_TYPE_AMD, "MX29LV320T 2Mx16 TopB      (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
    //--- End of Changes ----
-   { 0x00BF, 0x2783, size4MB, CMD_TYPE_SST, "SST39VF320 2Mx16           (4MB)"   ,64,size64K,   0,0,          0,0,        0,0        },
-   { 0x0020, 0x22CB, size4MB, CMD_TYPE_AMD, "ST 29w320DB 2Mx16 BotB     (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K },
-   { 0x0020, 0x22CA, size4MB, CMD_TYPE_AMD, "ST 29w320DT 2Mx16 TopB     (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K  },
-   { 0x00b0, 0x00e3, size4MB, CMD_TYPE_BSC, "Sharp 28F320BJE 2Mx16 BotB (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x0098, 0x009C, size4MB, CMD_TYPE_AMD, "TC58FVB321 2Mx16 BotB      (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K },
-   { 0x0098, 0x009A, size4MB, CMD_TYPE_AMD, "TC58FVT321 2Mx16 TopB      (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K  },
+   { 0x00BF, 0x2783, size4MB, CMD_TYPE_SST, "SST39VF320 2Mx16           (4MB)"   ,64,size64K,   0,0,          0,0,        0,0         ,0                  ,0 ,14 ,20 ,18  ,25    },
+   { 0x0020, 0x22CB, size4MB, CMD_TYPE_AMD, "ST 29w320DB 2Mx16 BotB     (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K  ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0020, 0x22CA, size4MB, CMD_TYPE_AMD, "ST 29w320DT 2Mx16 TopB     (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K   ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00b0, 0x00e3, size4MB, CMD_TYPE_BSC, "Sharp 28F320BJE 2Mx16 BotB (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,0                  ,0 ,12 ,200,1000,5000  },
+   { 0x0098, 0x009C, size4MB, CMD_TYPE_AMD, "TC58FVB321 2Mx16 BotB      (4MB)"   ,1,size16K,    2,size8K,     1,size32K,  63,size64K  ,0                  ,0 ,11 ,300,700 ,15000 },
+   { 0x0098, 0x009A, size4MB, CMD_TYPE_AMD, "TC58FVT321 2Mx16 TopB      (4MB)"   ,63,size64K,   1,size32K,    2,size8K,   1,size16K   ,0                  ,0 ,11 ,300,700 ,15000 },
    // --- Add a few new Flash Chip Definitions ---
-   { 0x001F, 0x00C0, size4MB, CMD_TYPE_AMD, "AT49BV/LV16X 2Mx16 BotB    (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0        },
-   { 0x001F, 0x00C2, size4MB, CMD_TYPE_AMD, "AT49BV/LV16XT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0        },
-   { 0x0004, 0x2249, size2MB, CMD_TYPE_AMD, "MBM29LV160B 1Mx16 BotB     (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K },
-   { 0x0004, 0x22c4, size2MB, CMD_TYPE_AMD, "MBM29LV160T 1Mx16 TopB     (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K  },
-   { 0x00C2, 0x2249, size2MB, CMD_TYPE_AMD, "MX29LV161B 1Mx16 BotB      (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K },
-   { 0x00C2, 0x22c4, size2MB, CMD_TYPE_AMD, "MX29LV161T 1Mx16 TopB      (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K  },
-   { 0x0020, 0x2249, size2MB, CMD_TYPE_AMD, "ST M29W160EB 1Mx16 BotB    (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K },
-   { 0x0020, 0x22c4, size2MB, CMD_TYPE_AMD, "ST M29W160ET 1Mx16 TopB    (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K  },
+   { 0x001F, 0x00C0, size4MB, CMD_TYPE_AMD, "AT49BV/LV16X 2Mx16 BotB    (4MB)"   ,8,size8K,     63,size64K,   0,0,        0,0         ,0                  ,0 ,11 ,300,700 ,15000 },
+   { 0x001F, 0x00C2, size4MB, CMD_TYPE_AMD, "AT49BV/LV16XT 2Mx16 TopB   (4MB)"   ,63,size64K,   8,size8K,     0,0,        0,0         ,0                  ,0 ,11 ,300,700 ,15000 },
+   { 0x0004, 0x2249, size2MB, CMD_TYPE_AMD, "MBM29LV160B 1Mx16 BotB     (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K  ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0004, 0x22c4, size2MB, CMD_TYPE_AMD, "MBM29LV160T 1Mx16 TopB     (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K   ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00C2, 0x2249, size2MB, CMD_TYPE_AMD, "MX29LV161B 1Mx16 BotB      (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K  ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00C2, 0x22c4, size2MB, CMD_TYPE_AMD, "MX29LV161T 1Mx16 TopB      (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K   ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0020, 0x2249, size2MB, CMD_TYPE_AMD, "ST M29W160EB 1Mx16 BotB    (2MB)"   ,1,size16K,    2,size8K,     1,size32K,  31,size64K  ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x0020, 0x22c4, size2MB, CMD_TYPE_AMD, "ST M29W160ET 1Mx16 TopB    (2MB)"   ,31,size64K,   1,size32K,    2,size8K,   1,size16K   ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
    // --- Add a few new Flash Chip Definitions ---
-   { 0x00BF, 0x234B, size4MB, CMD_TYPE_SST, "SST39VF1601 1Mx16 BotB     (2MB)"   ,64,size32K,    0,0,          0,0,        0,0        },
-   { 0x00BF, 0x234A, size4MB, CMD_TYPE_SST, "SST39VF1602 1Mx16 TopB     (2MB)"   ,64,size32K,    0,0,          0,0,        0,0        },
-   { 0x00BF, 0x235B, size4MB, CMD_TYPE_SST, "SST39VF3201 2Mx16 BotB     (4MB)"   ,128,size32K,   0,0,          0,0,        0,0        },
-   { 0x00BF, 0x235A, size4MB, CMD_TYPE_SST, "SST39VF3202 2Mx16 TopB     (4MB)"   ,128,size32K,   0,0,          0,0,        0,0        },
-   { 0x00BF, 0x236B, size4MB, CMD_TYPE_SST, "SST39VF6401 4Mx16 BotB     (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        },
-   { 0x00BF, 0x236A, size4MB, CMD_TYPE_SST, "SST39VF6402 4Mx16 TopB     (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        },
+   { 0x00BF, 0x234B, size4MB, CMD_TYPE_SST, "SST39VF1601 1Mx16 BotB     (2MB)"   ,64,size32K,    0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
+   { 0x00BF, 0x234A, size4MB, CMD_TYPE_SST, "SST39VF1602 1Mx16 TopB     (2MB)"   ,64,size32K,    0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
+   { 0x00BF, 0x235B, size4MB, CMD_TYPE_SST, "SST39VF3201 2Mx16 BotB     (4MB)"   ,128,size32K,   0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
+   { 0x00BF, 0x235A, size4MB, CMD_TYPE_SST, "SST39VF3202 2Mx16 TopB     (4MB)"   ,128,size32K,   0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
+   { 0x00BF, 0x236B, size4MB, CMD_TYPE_SST, "SST39VF6401 4Mx16 BotB     (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
+   { 0x00BF, 0x236A, size4MB, CMD_TYPE_SST, "SST39VF6402 4Mx16 TopB     (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
    // --- Add a few new Flash Chip Definitions ---
-   { 0x00EC, 0x2275, size2MB, CMD_TYPE_AMD, "K8D1716UTC  1Mx16 TopB     (2MB)"   ,31,size64K,    8,size8K,     0,0,        0,0        },
-   { 0x00EC, 0x2277, size2MB, CMD_TYPE_AMD, "K8D1716UBC  1Mx16 BotB     (2MB)"   ,8,size8K,      31,size64K,   0,0,        0,0        },
+   { 0x00EC, 0x2275, size2MB, CMD_TYPE_AMD, "K8D1716UTC  1Mx16 TopB     (2MB)"   ,31,size64K,    8,size8K,     0,0,        0,0        ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00EC, 0x2277, size2MB, CMD_TYPE_AMD, "K8D1716UBC  1Mx16 BotB     (2MB)"   ,8,size8K,      31,size64K,   0,0,        0,0        ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
    // --- Add a few new Flash Chip Definitions ---
-   { 0x00C2, 0x22DA, size1MB, CMD_TYPE_AMD, "MX29LV800BTC 512kx16 TopB  (1MB)"   ,15,size32K,    1,size16K,    2,size4K,   1,size8K   },
-   { 0x00C2, 0x225B, size1MB, CMD_TYPE_AMD, "MX29LV800BTC 512kx16 BotB  (1MB)"   ,1,size8K,      2,size4K,     1,size16K,  15,size32K },
+   { 0x00C2, 0x22DA, size1MB, CMD_TYPE_AMD, "MX29LV800BTC 512kx16 TopB  (1MB)"   ,15,size32K,    1,size16K,    2,size4K,   1,size8K   ,0                  ,0 ,11 ,300,700 ,15000 },
+   { 0x00C2, 0x225B, size1MB, CMD_TYPE_AMD, "MX29LV800BTC 512kx16 BotB  (1MB)"   ,1,size8K,      2,size4K,     1,size16K,  15,size32K ,0                  ,0 ,11 ,300,700 ,15000 },
    // --- Add a few new Flash Chip Definitions ---
-   { 0x00EC, 0x22A0, size2MB, CMD_TYPE_AMD, "K8D3216UTC  2Mx16 TopB     (4MB)"   ,63,size64K,    8,size8K,     0,0,        0,0        },
-   { 0x00EC, 0x22A2, size2MB, CMD_TYPE_AMD, "K8D3216UBC  2Mx16 BotB     (4MB)"   ,8,size8K,      63,size64K,   0,0,        0,0        },
+   { 0x00EC, 0x22A0, size2MB, CMD_TYPE_AMD, "K8D3216UTC  2Mx16 TopB     (4MB)"   ,63,size64K,    8,size8K,     0,0,        0,0        ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   { 0x00EC, 0x22A2, size2MB, CMD_TYPE_AMD, "K8D3216UBC  2Mx16 BotB     (4MB)"   ,8,size8K,      63,size64K,   0,0,        0,0        ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
    // --- Add a few new Flash Chip Definitions ---
-   { 0x00BF, 0x236D, size4MB, CMD_TYPE_SST, "SST39VF6401B 4Mx16 BotB    (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        },
-   { 0x00BF, 0x236C, size4MB, CMD_TYPE_SST, "SST39VF6402B 4Mx16 TopB    (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        },
+   { 0x00BF, 0x236D, size4MB, CMD_TYPE_SST, "SST39VF6401B 4Mx16 BotB    (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
+   { 0x00BF, 0x236C, size4MB, CMD_TYPE_SST, "SST39VF6402B 4Mx16 TopB    (8MB)"   ,256,size32K,   0,0,          0,0,        0,0        ,0                  ,0 ,14 ,20 ,18  ,25    },
    // --- Add a new Flash Chip Definition ---
    // id's may be bigendian instead of littleendian
-   { 0x1000, 0x0278, size4MB, CMD_TYPE_AMD, "MBM29DL32BF 2Mx16 BotB     (4MB)",   8,size8K,     7,size64K,    24, size64K, 32,size64K },
+   { 0x1000, 0x0278, size4MB, CMD_TYPE_AMD, "MBM29DL32BF 2Mx16 BotB     (4MB)",   8,size8K,     7,size64K,    24, size64K, 32,size64K ,FLAG_UNLOCK_BYPASS | FLAG_BANK_SPLIT(2) ,0 ,11 ,300,700 ,15000 },
    // --- Add a new Flash Chip Definition ---
-   { 0x00c2, 0x227e, size8MB, CMD_TYPE_AMD, "MX29LV640MB 4Mx16 BotB    (8MB)"   ,8,size8K, 127,size64K,      0,0,        0,0   },
+   { 0x00c2, 0x227e, size8MB, CMD_TYPE_AMD, "MX29LV640MB 4Mx16 BotB    (8MB)"   ,8,size8K, 127,size64K,      0,0,        0,0          ,FLAG_UNLOCK_BYPASS ,0 ,11 ,300,700 ,15000 },
+   // --- Serial Flash behind Broadcom chipcommon (ids are the RES signature) ---
+   { 0x0020, 0x0013, size1MB, CMD_TYPE_SPI, "ST M25P80 Serial           (1MB)"   ,16,size64K,   0,0,          0,0,        0,0         ,0                  ,256 ,1400,5000,1000,3000  },
+   { 0x0020, 0x0014, size2MB, CMD_TYPE_SPI, "ST M25P16 Serial           (2MB)"   ,32,size64K,   0,0,          0,0,        0,0         ,0                  ,256 ,1400,5000,1000,3000  },
+   { 0x0020, 0x0015, size4MB, CMD_TYPE_SPI, "ST M25P32 Serial           (4MB)"   ,64,size64K,   0,0,          0,0,        0,0         ,0                  ,256 ,1400,5000,1000,3000  },
+   { 0x0020, 0x0016, size8MB, CMD_TYPE_SPI, "ST M25P64 Serial           (8MB)"   ,128,size64K,  0,0,          0,0,        0,0         ,0                  ,256 ,1400,5000,1000,3000  },
+   { 0x00BF, 0x008E, size1MB, CMD_TYPE_SPI, "SST25VF080B Serial         (1MB)"   ,16,size64K,   0,0,          0,0,        0,0         ,0                  ,0   ,7  ,10 ,18  ,25     },
+   { 0x00BF, 0x0041, size2MB, CMD_TYPE_SPI, "SST25VF016B Serial         (2MB)"   ,32,size64K,   0,0,          0,0,        0,0         ,0                  ,0   ,7  ,10 ,18  ,25     },
+   { 0x00BF, 0x004A, size4MB, CMD_TYPE_SPI, "SST25VF032B Serial         (4MB)"   ,64,size64K,   0,0,          0,0,        0,0         ,0                  ,0   ,7  ,10 ,18  ,25     },
    // --- End of Flash Chip Definitions
-   { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+   { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
    };
 
 
@@ -514,6 +844,124 @@ static unsigned char clockin(int tms, int tdi)
 }
 
 
+// Pin states for every TDI byte (TCK low then high per bit), plus the TMS
+// bit each TMS byte adds to them - a whole scan vector is a lookup per 8 bits
+void scan_setup(void)
+{
+   int b, i, tdi;
+   unsigned char low, tms;
+
+   for (b = 0; b < 256; b++)
+   {
+      for (i = 0; i < 8; i++)
+      {
+         tdi = (b >> i) & 1;
+         if (wiggler)  {  low = (1 << WTDO) | (tdi << WTDI) | (1 << WTRST_N);  tms = (1 << WTMS);  }
+         else          {  low = (1 << TDO) | (tdi << TDI);                     tms = (1 << TMS);   }
+         scan_tdi_table[b][i * 2]     = low;
+         scan_tdi_table[b][i * 2 + 1] = low | (1 << (wiggler ? WTCK : TCK));
+         scan_tms_table[b][i * 2]     = ((b >> i) & 1) ? tms : 0;
+         scan_tms_table[b][i * 2 + 1] = ((b >> i) & 1) ? tms : 0;
+      }
+   }
+
+   // Busy is inverted by the port, so the wiggler's TDO comes back flipped
+   scan_tdo_bit    = wiggler ? WTDO : TDO;
+   scan_tdo_invert = wiggler;
+}
+
+
+// Two pin states per clock; pins must hold clocks rounded up to 8 (x2)
+void scan_expand(unsigned char *pins, unsigned long long tdi, unsigned long long tms, int clocks)
+{
+   int i, j;
+   unsigned char *t, *m;
+
+   for (i = 0; i < clocks; i += 8, tdi >>= 8, tms >>= 8)
+   {
+      t = scan_tdi_table[tdi & 0xff];
+      m = scan_tms_table[tms & 0xff];
+      #ifdef SCAN_SSE2
+      if (scan_simd)
+      {
+         _mm_storeu_si128((__m128i *)(pins + i * 2), _mm_or_si128(_mm_loadu_si128((__m128i *)t), _mm_loadu_si128((__m128i *)m)));
+         continue;
+      }
+      #endif
+      for (j = 0; j < 16; j++)  pins[i * 2 + j] = t[j] | m[j];
+   }
+}
+
+
+// TDO from one status sample per clock back into a word (bit 0 first)
+unsigned int scan_pack(unsigned char *status, int bits)
+{
+   unsigned int word = 0;
+   int i = 0;
+
+   #ifdef SCAN_SSE2
+   if (scan_simd)
+   {
+      // Shift TDO up to each byte's top bit and take all 16 at once
+      for (; (i + 16) <= bits; i += 16)
+         word |= (unsigned int)_mm_movemask_epi8(_mm_sll_epi16(_mm_loadu_si128((__m128i *)(status + i)), _mm_cvtsi32_si128(7 - scan_tdo_bit))) << i;
+   }
+   #endif
+   for (; i < bits; i++)
+      word |= (unsigned int)((status[i] >> scan_tdo_bit) & 1) << i;
+
+   if (scan_tdo_invert)  word ^= (bits >= 32) ? 0xFFFFFFFF : ((1u << bits) - 1);
+   return word;
+}
+
+
+// Clock a precomputed vector out, sampling the status lines once per clock
+static void scan_clock(unsigned char *pins, unsigned char *status, int clocks)
+{
+   int i;
+
+   for (i = 0; i < clocks; i++)
+   {
+      #ifdef WINDOWS_VERSION   // ---- Compiler Specific Code ----
+         _outp(0x378, pins[i * 2]);
+         _outp(0x378, pins[i * 2 + 1]);
+         status[i] = (unsigned char)_inp(0x379);
+      #else
+         ioctl(pfd, PPWDATA, &pins[i * 2]);
+         ioctl(pfd, PPWDATA, &pins[i * 2 + 1]);
+         ioctl(pfd, PPRSTATUS, &status[i]);
+      #endif
+   }
+}
+
+
+double get_seconds(void)
+{
+   #ifdef WINDOWS_VERSION   // ---- Compiler Specific Code ----
+
+      return (double)GetTickCount() / 1000.0;
+
+   #else                    // ---- Compiler Specific Code ----
+
+      struct timeval tv;
+
+      gettimeofday(&tv, NULL);
+      return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+
+   #endif
+}
+
+
+void sleep_ms(unsigned int ms)
+{
+   #ifdef WINDOWS_VERSION   // ---- Compiler Specific Code ----
+      Sleep(ms);
+   #else                    // ---- Compiler Specific Code ----
+      usleep(ms * 1000);
+   #endif
+}
+
+
 // ---------------------------------------
 // ---- End of Compiler Specific Code ----
 // ---------------------------------------
@@ -532,22 +980,19 @@ void test_reset(void)
 
 void set_instr(int instr)
 {
-    int i;
+    unsigned char pins[SCAN_MAX_CLOCKS * 2];
+    unsigned char status[SCAN_MAX_CLOCKS];
+    unsigned long long bits;
     static int curinstr = 0xFFFFFFFF;
 
     if (instr == curinstr)
        return;
 
-    clockin(1, 0);  // enter select-dr-scan
-    clockin(1, 0);  // enter select-ir-scan
-    clockin(0, 0);  // enter capture-ir
-    clockin(0, 0);  // enter shift-ir (dummy)
-    for (i=0; i < instruction_length; i++)
-    {
-        clockin(i==(instruction_length - 1), (instr>>i)&1);
-    }
-    clockin(1, 0);  // enter update-ir
-    clockin(0, 0);  // enter runtest-idle
+    // select-dr-scan, select-ir-scan, capture-ir, shift-ir (dummy), the
+    // instruction (TMS on its last bit), update-ir, runtest-idle
+    bits = (unsigned int)instr & ((1ULL << instruction_length) - 1);
+    scan_expand(pins, bits << 4, 0x3ULL | (0x3ULL << (instruction_length + 3)), instruction_length + 6);
+    scan_clock(pins, status, instruction_length + 6);
 
     curinstr = instr;
 }
@@ -555,21 +1000,14 @@ void set_instr(int instr)
 
 static unsigned int ReadWriteData(unsigned int in_data)
 {
-    int i;
-    unsigned int out_data = 0;
-    unsigned char out_bit;
-
-    clockin(1, 0);  // enter select-dr-scan
-    clockin(0, 0);  // enter capture-dr
-    clockin(0, 0);  // enter shift-dr
-    for(i = 0 ; i < 32 ; i++)
-    {
-       out_bit  = clockin((i == 31), ((in_data >> i) & 1));
-       out_data = out_data | (out_bit << i);
-    }
-    clockin(1,0);   // enter update-dr
-    clockin(0,0);   // enter runtest-idle
-    return out_data;
+    unsigned char pins[SCAN_MAX_CLOCKS * 2];
+    unsigned char status[SCAN_MAX_CLOCKS];
+
+    // select-dr-scan, capture-dr, shift-dr, 32 data bits (TMS on the last),
+    // update-dr, runtest-idle
+    scan_expand(pins, (unsigned long long)in_data << 3, SCAN_DR_TMS, 37);
+    scan_clock(pins, status, 37);
+    return scan_pack(status + 3, 32);
 }
 
 
@@ -594,8 +1032,42 @@ void ShowData(unsigned int value)
 }
 
 
+static unsigned int flash_bank_addr(unsigned int addr)
+{
+   unsigned int offset;
+   int bank;
+
+   // Only Flash Beyond The CPU Window Needs Banking
+   if (!bank_register || (addr < FLASH_MEMORY_START) || (addr >= (FLASH_MEMORY_START + flash_size)))  return addr;
+
+   offset = addr - FLASH_MEMORY_START;
+   bank   = offset / flash_window_size;
+   if (bank != bank_current)
+   {
+      if (USE_DMA) ejtag_dma_write(bank_register, bank);
+      else ejtag_pracc_write(bank_register, bank);
+      bank_current = bank;
+   }
+
+   return (FLASH_MEMORY_START + (offset % flash_window_size));
+}
+
+
+static unsigned int flash_bank_words(unsigned int addr, unsigned int count)
+{
+   unsigned int left;
+
+   // Words Of A Block That Stay In The Same Bank Window As Its First One
+   if (!bank_register || (addr < FLASH_MEMORY_START) || (addr >= (FLASH_MEMORY_START + flash_size)))  return count;
+
+   left = (flash_window_size - ((addr - FLASH_MEMORY_START) % flash_window_size)) / 4;
+   return (count < left) ? count : left;
+}
+
+
 static unsigned int ejtag_read(unsigned int addr)
 {
+   addr = flash_bank_addr(addr);
    if (USE_DMA) return(ejtag_dma_read(addr));
    else return(ejtag_pracc_read(addr));
 
@@ -604,6 +1076,7 @@ static unsigned int ejtag_read(unsigned int addr)
 
 static unsigned int ejtag_read_h(unsigned int addr)
 {
+   addr = flash_bank_addr(addr);
    if (USE_DMA) return(ejtag_dma_read_h(addr));
    else return(ejtag_pracc_read_h(addr));
 
@@ -612,6 +1085,7 @@ static unsigned int ejtag_read_h(unsigned int addr)
 
 void ejtag_write(unsigned int addr, unsigned int data)
 {
+   addr = flash_bank_addr(addr);
    if (USE_DMA) ejtag_dma_write(addr, data);
    else ejtag_pracc_write(addr, data);
 }
@@ -619,6 +1093,7 @@ void ejtag_write(unsigned int addr, unsigned int data)
 
 void ejtag_write_h(unsigned int addr, unsigned int data)
 {
+   addr = flash_bank_addr(addr);
    if (USE_DMA) ejtag_dma_write_h(addr, data);
    else ejtag_pracc_write_h(addr, data);
 }
@@ -797,12 +1272,208 @@ void ejtag_pracc_write_h(unsigned int addr, unsigned int data)
 }
 
 
+static unsigned int ejtag_pracc_poll_h(unsigned int addr, unsigned int mask, unsigned int value)
+{
+   // The module loops on the half word until the masked value matches (or
+   // its poll count runs out), so the address / mask / value setup and the
+   // data hand back happen once per wait.  It still runs from dmseg, so each
+   // pass of the loop is about 6 instruction fetches over PrAcc - cheaper
+   // than a read module per poll, but not free (see ejtag_poll_h).
+   address_register = addr | 0xA0000000;  // Force to use uncached segment
+   mask_register    = mask;
+   value_register   = value & mask;
+   data_register    = ~value_register;
+   ExecuteDebugModule(pracc_pollhalf_code_module);
+
+   return(data_register);
+}
+
+
+void ejtag_read_block(unsigned int addr, unsigned int *data, unsigned int count)
+{
+   unsigned int run;
+
+   // A Block Crossing A Bank Window Goes Over As One Transfer Per Bank
+   while (count)
+   {
+      run = flash_bank_words(addr, count);
+      if (USE_DMA) ejtag_dma_read_block(flash_bank_addr(addr), data, run);
+      else ejtag_pracc_read_block(flash_bank_addr(addr), data, run);
+      addr  += run * 4;
+      data  += run;
+      count -= run;
+   }
+}
+
+
+void ejtag_write_block(unsigned int addr, unsigned int *data, unsigned int count)
+{
+   unsigned int run;
+
+   while (count)
+   {
+      run = flash_bank_words(addr, count);
+      if (USE_DMA) ejtag_dma_write_block(flash_bank_addr(addr), data, run);
+      else ejtag_pracc_write_block(flash_bank_addr(addr), data, run);
+      addr  += run * 4;
+      data  += run;
+      count -= run;
+   }
+}
+
+
+void ejtag_dma_read_block(unsigned int addr, unsigned int *data, unsigned int count)
+{
+   while (count--)
+   {
+      *data++ = ejtag_dma_read(addr);
+      addr += 4;
+   }
+}
+
+
+void ejtag_dma_write_block(unsigned int addr, unsigned int *data, unsigned int count)
+{
+   while (count--)
+   {
+      ejtag_dma_write(addr, *data++);
+      addr += 4;
+   }
+}
+
+
+void ejtag_pracc_read_block(unsigned int addr, unsigned int *data, unsigned int count)
+{
+   if (count == 0)  return;
+
+   // The CPU walks the block itself and pushes each word through the
+   // pseudo-fifo register, so there is no per word address/data setup.
+   address_register = addr | 0xA0000000;  // Force to use uncached segment
+   value_register   = count;
+   fifo_buffer      = data;
+   fifo_index       = 0;
+   fifo_count       = count;
+   ExecuteDebugModule(pracc_readblock_code_module);
+   fifo_count       = 0;
+}
+
+
+void ejtag_pracc_write_block(unsigned int addr, unsigned int *data, unsigned int count)
+{
+   if (count == 0)  return;
+
+   address_register = addr | 0xA0000000;  // Force to use uncached segment
+   value_register   = count;
+   fifo_buffer      = data;
+   fifo_index       = 0;
+   fifo_count       = count;
+   ExecuteDebugModule(pracc_writeblock_code_module);
+   fifo_count       = 0;
+}
+
+
+void ejtag_pracc_cache_sync(unsigned int addr, unsigned int length)
+{
+   unsigned int first_line = addr & ~(MIPS_CACHE_LINE_SIZE - 1);
+   unsigned int last_line  = (addr + length + MIPS_CACHE_LINE_SIZE - 1) & ~(MIPS_CACHE_LINE_SIZE - 1);
+
+   if (length == 0)  return;
+
+   address_register = (first_line & 0x1FFFFFFF) | 0x80000000;  // Hit ops need the cached segment
+   value_register   = (last_line - first_line) / MIPS_CACHE_LINE_SIZE;
+   ExecuteDebugModule(pracc_cachesync_code_module);
+}
+
+
+void ejtag_pracc_resume(unsigned int pc)
+{
+   address_register = pc;
+   ExecuteDebugModule(pracc_resume_code_module);
+}
+
+
+int ejtag_call_helper(unsigned int *helper, unsigned int helper_words, unsigned int *list, unsigned int list_words, unsigned int param, unsigned int *result)
+{
+   unsigned int check[RAM_HELPER_LIST_OFFSET / 4];
+   unsigned int helper_phys = ram_helper_addr & 0x1FFFFFFF;
+   unsigned int i;
+
+   if (!ram_helper_addr)  return 0;
+
+   // Helpers Are Started By A PrAcc Module - Nothing Would Run It Outside Debug Mode
+   if (!debug_mode)
+   {
+      printf("\n*** Processor not in debug mode - RAM helpers disabled ***\n");
+      ram_helper_addr = 0;
+      return 0;
+   }
+
+   // Code fetched over PrAcc is far too slow for timing critical command
+   // sequences, so these run from target RAM at full speed instead.
+   if (ram_helper_loaded != helper)
+   {
+      ejtag_write_block(helper_phys, helper, helper_words);
+      ejtag_read_block(helper_phys, check, helper_words);
+      for (i = 0; i < helper_words; i++)
+      {
+         if (check[i] != helper[i])
+         {
+            printf("\n*** RAM at %08x did not read back (SDRAM not set up?) - RAM helpers disabled ***\n", ram_helper_addr);
+            ram_helper_addr = 0;
+            return 0;
+         }
+      }
+      ejtag_pracc_cache_sync(helper_phys | 0x80000000, helper_words * 4);
+      ram_helper_loaded = helper;
+   }
+
+   ejtag_write_block(helper_phys + RAM_HELPER_LIST_OFFSET, list, list_words);
+
+   address_register = helper_phys | 0xA0000000;  // Run it uncached
+   mask_register    = param;
+   value_register   = list_words;
+   ExecuteDebugModule(pracc_callhelper_code_module);
+
+   *result = data_register;
+   return 1;
+}
+
+
+static unsigned int ejtag_poll_h(unsigned int addr, unsigned int mask, unsigned int value)
+{
+   unsigned int list[3], result;
+
+   // From RAM The Same Loop Runs At Full Speed With No PrAcc Fetch Per Pass
+   list[0] = addr | 0xA0000000;  // Force to use uncached segment
+   list[1] = mask;
+   list[2] = value & mask;
+   if (ejtag_call_helper(pollhalf_ram_helper, sizeof(pollhalf_ram_helper) / 4, list, 3, 0, &result))  return result;
+
+   return ejtag_pracc_poll_h(addr, mask, value);
+}
+
+
+static unsigned int fifo_check(void)
+{
+   // More Fifo Words Than The Block Holds - Module & Host Are Out Of Step
+   if (fifo_index >= fifo_count)
+   {
+      printf("\n*** PrAcc fifo overrun (word %d of %d) - giving up ***\n\n", fifo_index + 1, fifo_count);
+      chip_shutdown();
+      exit(1);
+   }
+   return fifo_index++;
+}
+
+
 void ExecuteDebugModule(unsigned int *pmodule)
 {
    unsigned int ctrl_reg;
-   unsigned int address;
+   unsigned int address = 0;
    unsigned int data   = 0;
+   unsigned int fed    = 0;
    unsigned int offset = 0;
+   double wait_start;
    int finished = 0;
    int DEBUGMSG = 0;
       
@@ -812,6 +1483,7 @@ void ExecuteDebugModule(unsigned int *pmodule)
    while (1)
    {
       // Read the control register.  Make sure an access is requested, then do it.
+      wait_start = 0;
       while(1) 
       {
          set_instr(INSTR_CONTROL);
@@ -819,6 +1491,15 @@ void ExecuteDebugModule(unsigned int *pmodule)
          if (ctrl_reg & PRACC)
             break;
          if (DEBUGMSG) printf("DEBUGMODULE: No memory access in progress!\n");
+
+         // Processor Stopped Fetching (left debug mode or hung) - Nothing Will Come
+         if (!wait_start)  wait_start = get_seconds();
+         else if ((get_seconds() - wait_start) > PRACC_TIMEOUT)
+         {
+            printf("\n*** Processor stopped making PrAcc accesses (address = %08x) - giving up ***\n\n", address);
+            chip_shutdown();
+            exit(1);
+         }
       }
       
       set_instr(INSTR_ADDRESS);
@@ -841,6 +1522,9 @@ void ExecuteDebugModule(unsigned int *pmodule)
          // If processor is writing to one of our psuedo virtual registers then save off data
          if (address == MIPS_VIRTUAL_ADDRESS_ACCESS)  address_register = data;
          if (address == MIPS_VIRTUAL_DATA_ACCESS)     data_register    = data;
+         if (address == MIPS_VIRTUAL_MASK_ACCESS)     mask_register    = data;
+         if (address == MIPS_VIRTUAL_VALUE_ACCESS)    value_register   = data;
+         if (address == MIPS_VIRTUAL_FIFO_ACCESS)     fifo_buffer[fifo_check()] = data;
       }
       
       else
@@ -874,15 +1558,27 @@ void ExecuteDebugModule(unsigned int *pmodule)
             // If processor is reading from one of our psuedo virtual registers then give it data
             if (address == MIPS_VIRTUAL_ADDRESS_ACCESS)  data = address_register;
             if (address == MIPS_VIRTUAL_DATA_ACCESS)     data = data_register;
+            if (address == MIPS_VIRTUAL_MASK_ACCESS)     data = mask_register;
+            if (address == MIPS_VIRTUAL_VALUE_ACCESS)    data = value_register;
+            if (address == MIPS_VIRTUAL_FIFO_ACCESS)     data = fifo_buffer[fifo_check()];
          }
       
-         // Send the data out
+         // Send the data out (what shifts back in is the previous word, not this one)
+         fed = data;
          set_instr(INSTR_DATA);
          data = ReadWriteData(data);
       
          // Clear the access pending bit (let the processor eat!)
          set_instr(INSTR_CONTROL);
          ctrl_reg = ReadWriteData(PROBEN | SETDEV);
+
+         // Once a DERET has been fed the processor leaves Debug Mode and
+         // never comes back to the debug vector, so we are done here.
+         if ((address >= MIPS_DEBUG_VECTOR_ADDRESS) && (fed == MIPS_DERET_INSTRUCTION))
+         {
+            if (DEBUGMSG) printf("DEBUGMODULE: Left Debug Mode.\n");
+            return;
+         }
       
       }
    }
@@ -896,6 +1592,7 @@ void chip_detect(void)
     processor_chip_type*   processor_chip = processor_chip_list;
 
     lpt_openport();
+    scan_setup();
 
     printf("Probing bus ... ");
     
@@ -906,6 +1603,7 @@ void chip_detect(void)
        instruction_length = instrlen;
        set_instr(INSTR_IDCODE);
        id = ReadData();
+       cpu_chip_id = id;
        printf("Done\n\n");
        printf("Instruction Length set to %d\n\n",instruction_length);
        printf("CPU Chip ID: ");  ShowData(id);  printf("*** CHIP DETECTION OVERRIDDEN ***\n\n");
@@ -925,6 +1623,7 @@ void chip_detect(void)
           id = ReadData();
           if (id == processor_chip->chip_id)
           {
+             cpu_chip_id = id;
              printf("Done\n\n");
              printf("Instruction Length set to %d\n\n",instruction_length);
              printf("CPU Chip ID: ");  ShowData(id);  printf("*** Found a %s chip ***\n\n", processor_chip->chip_descr);
@@ -968,6 +1667,7 @@ void check_ejtag_features()
 
     // EJTAG DMA Support
     USE_DMA = !(features & (1 << 14));
+    DMA_SUPPORTED = USE_DMA;
     printf("    - EJTAG DMA Support ... : %s\n", USE_DMA ? "Yes" : "No");
 
     if (force_dma)   { USE_DMA = 1;  printf("    *** DMA Mode Forced On ***\n"); }
@@ -985,604 +1685,4271 @@ void chip_shutdown(void)
 }
 
 
-void run_backup(char *filename, unsigned int start, unsigned int length)
+// **************************************************************************
+// Image File I/O
+//
+// Files are memory mapped where the OS allows it - backups into a mapping
+// pre-sized to the area, flash images through a private (copy on write)
+// mapping of a read-only file.  Windows builds, and images shorter than the
+// area, fall back to one buffered read or write of the whole file.
+// **************************************************************************
+
+static unsigned char* image_open(image_file_type *img, char *filename, unsigned int length, int writable)
 {
-    unsigned int addr, data;
     FILE *fd;
-    int counter = 0;
-    int percent_complete = 0;
-    char newfilename[128] = "";
-    time_t start_time = time(0);
-    time_t end_time, elapsed_seconds;
-
-    struct tm* lt = localtime(&start_time);
-    char time_str[15];
-    
-    sprintf(time_str, "%04d%02d%02d_%02d%02d%02d",
-        lt->tm_year + 1900, lt->tm_mon + 1, lt->tm_mday,
-        lt->tm_hour, lt->tm_min, lt->tm_sec
-    );
+    unsigned int file_size = 0;
 
-    printf("*** You Selected to Backup the %s ***\n\n",filename);
+    memset(img, 0, sizeof(*img));
+    img->name     = filename;
+    img->writable = writable;
 
-    strcpy(newfilename,filename);
-    strcat(newfilename,".SAVED");
-    if (issue_timestamp)
+#ifndef WINDOWS_VERSION
     {
-       strcat(newfilename,"_");
-       strcat(newfilename,time_str);
+       struct stat st;
+       int handle;
+
+       // 2 = Writable But Keep What Is There (resumed backups)
+       handle = open(filename, writable ? (O_RDWR | O_CREAT | ((writable == 1) ? O_TRUNC : 0)) : O_RDONLY, 0644);
+       if (handle < 0)
+       {
+          fprintf(stderr,"Could not open %s for %s\n", filename, writable ? "writing" : "reading");
+          exit(1);
+       }
+
+       if (writable)
+       {
+          // Backups Are Sized Up Front - Then Just Filled In
+          if (length && (ftruncate(handle, length) == 0))  file_size = length;
+       }
+       else if (fstat(handle, &st) == 0)
+       {
+          file_size = st.st_size;
+          if (!length)  length = file_size;
+       }
+
+       img->length = length;
+       if (length && (file_size >= length))
+       {
+          img->data = mmap(NULL, length, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, handle, 0);
+          if (img->data == MAP_FAILED)  img->data = NULL;
+          else img->mapped = 1;
+       }
+       close(handle);
+
+       if (img->mapped)  return img->data;
     }
+#endif
 
-    fd = fopen(newfilename, "wb" );
-    if (fd<=0)
+    // Fallback - Whole File In One Buffer (0xFF's in case file is shorter than expected length)
+    if (!writable)
     {
-        fprintf(stderr,"Could not open %s for writing\n", newfilename);
-        exit(1);
+       fd = fopen(filename, "rb" );
+       if (fd<=0)
+       {
+          fprintf(stderr,"Could not open %s for reading\n", filename);
+          exit(1);
+       }
+       if (!length)
+       {
+          fseek(fd, 0, SEEK_END);
+          length = ftell(fd);
+          fseek(fd, 0, SEEK_SET);
+       }
     }
 
-    printf("=========================\n");
-    printf("Backup Routine Started\n");
-    printf("=========================\n");
+    img->length = length;
+    img->data   = malloc(length + 4);
+    if (img->data == NULL)
+    {
+       fprintf(stderr,"Could not allocate %d bytes for %s\n", length, filename);
+       exit(1);
+    }
+    memset(img->data, 0xFF, length + 4);
 
-    printf("\nSaving %s to Disk...\n",newfilename);
-    for(addr=start; addr<(start+length); addr+=4)
+    if (!writable)
     {
-        counter += 4;
-        percent_complete = (counter * 100 / length);
-        if (!silent_mode)
-           if ((addr&0xF) == 0)  printf("[%3d%% Backed Up]   %08x: ", percent_complete, addr);
-         
-        data = ejtag_read(addr);
+       fread(img->data, 1, length, fd);
+       fclose(fd);
+    }
 
-	if (bigendianfile) {
-	  data = swap_bytes(data, 4);
-	}
+    return img->data;
+}
 
-       fwrite( (unsigned char*) &data, 1, sizeof(data), fd);
 
-       if (silent_mode)  printf("%4d%%   bytes = %d\r", percent_complete, counter);
-       else              printf("%08x%c", data, (addr&0xF)==0xC?'\n':' ');
-       
-       fflush(stdout); 
-    }
-    fclose(fd);
+static void image_close(image_file_type *img)
+{
+    FILE *fd;
 
-    printf("Done  (%s saved to Disk OK)\n\n",newfilename);
+#ifndef WINDOWS_VERSION
+    if (img->mapped)
+    {
+       munmap(img->data, img->length);
+       img->data = NULL;
+       return;
+    }
+#endif
 
-    printf("bytes written: %d\n", counter);
-    
-    printf("=========================\n");
-    printf("Backup Routine Complete\n");
-    printf("=========================\n");
+    if (img->writable)
+    {
+       fd = fopen(img->name, "wb" );
+       if ((fd<=0) || (fwrite(img->data, 1, img->length, fd) != img->length))
+       {
+          fprintf(stderr,"Could not write %s\n", img->name);
+          exit(1);
+       }
+       fclose(fd);
+    }
 
-    time(&end_time);
-    elapsed_seconds = difftime(end_time, start_time); 
-    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+    free(img->data);
+    img->data = NULL;
 }
 
 
-
-void run_flash(char *filename, unsigned int start, unsigned int length)
+static void image_sync(image_file_type *img)
 {
-    unsigned int addr, data;
-    FILE *fd ;
-    int counter = 0;
-    int percent_complete = 0;
-    time_t start_time = time(0);
-    time_t end_time, elapsed_seconds;
+#ifndef WINDOWS_VERSION
+    // Mapped Pages On Disk Before The Journal Says So
+    if (img->mapped)  msync(img->data, img->length, MS_SYNC);
+#endif
+}
 
-    printf("*** You Selected to Flash the %s ***\n\n",filename);
 
-    fd=fopen(filename, "rb" );
-    if (fd<=0)
+void image_swap(unsigned int *data, unsigned int words)
+{
+    unsigned int i, w;
+
+    // Whole Buffer In One Pass - Shifts & Masks Compile Down To Byte Swap Instructions
+    for (i = 0; i < words; i++)
     {
-        fprintf(stderr,"Could not open %s for reading\n", filename);
-        exit(1);
+       w = data[i];
+       data[i] = (w >> 24) | ((w >> 8) & 0xFF00) | ((w << 8) & 0xFF0000) | (w << 24);
     }
-    printf("=========================\n");
-    printf("Flashing Routine Started\n");
-    printf("=========================\n");
+}
 
-    if (issue_erase) sflash_erase_area(start,length);
 
-    printf("\nLoading %s to Flash Memory...\n",filename);
-    for(addr=start; addr<(start+length); addr+=4)
+unsigned int image_hash(unsigned int *data, unsigned int words)
+{
+    unsigned int hash = 0x811C9DC5;
+    unsigned int i;
+
+    // FNV-1a, A Word At A Time
+    for (i = 0; i < words; i++)
+    {
+       hash ^= data[i];
+       hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+
+// **************************************************************************
+// Operation Journal
+//
+// Backups and flashes append what they have finished to <file>.journal - a
+// header line, then one line per erased, started or finished block (or per
+// range saved, for backups).  It goes to disk every JOURNAL_SYNC_INTERVAL
+// and is removed once the operation completes.  /resume replays a journal
+// left behind by an interrupted run and carries on from where it stopped.
+// **************************************************************************
+
+int journal_open(char *name, char *op, char *file, unsigned int start, unsigned int length, unsigned int hash)
+{
+    FILE *fd;
+    char line[256], key[128], word[16];
+    char *p;
+    unsigned int addr, end;
+    int cur_block, resumed = 0;
+
+    sprintf(journal_name, "%s.journal", name);
+    sprintf(key, "debrick journal op=%s start=%08x length=%08x hash=%08x", op, start, length, hash);
+
+    free(journal_state);
+    journal_state = calloc(block_total + 1, 1);
+    if (journal_state == NULL)
+    {
+       fprintf(stderr,"Could not allocate %d bytes for the journal\n", block_total + 1);
+       exit(1);
+    }
+    journal_resume_addr = start;
+    journal_done_blocks = 0;
+    strcpy(journal_file, file);
+
+    if (issue_resume && ((fd = fopen(journal_name, "r")) != NULL))
+    {
+       // Same Operation On The Same Area (and image) Or Nothing
+       if (fgets(line, sizeof(line), fd) && (strncmp(line, key, strlen(key)) == 0))
+       {
+          resumed = 1;
+          if ((p = strstr(line, " file=")) != NULL)
+          {
+             strncpy(journal_file, p + 6, sizeof(journal_file) - 1);
+             journal_file[sizeof(journal_file) - 1] = 0;
+             journal_file[strcspn(journal_file, "\r\n")] = 0;
+          }
+
+          while (fgets(line, sizeof(line), fd))
+          {
+             // A Torn Last Line Just Does Not Parse
+             if (sscanf(line, "%15s %x %x", word, &addr, &end) != 3)  continue;
+
+             if (strcmp(word, "read") == 0)
+             {
+                if ((addr == journal_resume_addr) && (end > addr))  journal_resume_addr = end;
+                continue;
+             }
+
+             cur_block = sflash_block_of(addr);
+             if (!cur_block)  continue;
+             if (strcmp(word, "erased") == 0)   journal_state[cur_block] = JOURNAL_ERASED;
+             if (strcmp(word, "started") == 0)  journal_state[cur_block] = JOURNAL_STARTED;
+             if (strcmp(word, "done") == 0)     journal_state[cur_block] = JOURNAL_DONE;
+          }
+       }
+       fclose(fd);
+
+       if (resumed)  printf("Resuming from %s\n", journal_name);
+       else printf("%s is for another operation - starting from the beginning\n", journal_name);
+    }
+    else if (issue_resume)  printf("No %s - starting from the beginning\n", journal_name);
+
+    journal_fd = fopen(journal_name, resumed ? "a" : "w");
+    if (journal_fd == NULL)
+    {
+       printf("*** Could not write %s - this run can not be resumed ***\n", journal_name);
+       return resumed;
+    }
+
+    // Blank Line Ends Any Torn Record Left By The Last Run
+    if (resumed)  fprintf(journal_fd, "\n");
+    else fprintf(journal_fd, "%s file=%s\n", key, file);
+    journal_sync(1);
+
+    return resumed;
+}
+
+
+void journal_sync(int force)
+{
+    double now = get_seconds();
+
+    if (!journal_fd)  return;
+
+    // Every Record Leaves The Process, Only Some Wait For The Disk
+    fflush(journal_fd);
+    if (!force && ((now - journal_synced) < JOURNAL_SYNC_INTERVAL))  return;
+#ifndef WINDOWS_VERSION
+    fsync(fileno(journal_fd));
+#endif
+    journal_synced = now;
+}
+
+
+void journal_note(char *what, unsigned int addr, unsigned int end, int sync)
+{
+    if (!journal_fd)  return;
+    fprintf(journal_fd, "%s %08x %08x\n", what, addr, end);
+    journal_sync(sync);
+}
+
+
+void journal_erased(int first_block, int last_block)
+{
+    int cur_block;
+
+    for (cur_block = first_block;  cur_block && (cur_block <= last_block);  cur_block++)
+       journal_note("erased", sflash_block_start(cur_block), sflash_block_start(cur_block) + sflash_block_size(cur_block), 0);
+}
+
+
+int journal_block_done(unsigned int addr)
+{
+    int cur_block;
+
+    if (!journal_state)  return 0;
+    cur_block = sflash_block_of(addr);
+    return (cur_block && (journal_state[cur_block] == JOURNAL_DONE));
+}
+
+
+void journal_apply(unsigned int *image, unsigned int start, unsigned int length)
+{
+    unsigned int *current = NULL;
+    unsigned int block_start, block_end, words;
+    unsigned int end = start + length;
+    int cur_block, first_block, last_block;
+    int erased = 0, redo = 0;
+
+    if (!journal_state)  return;
+
+    sflash_blocks_in(start, end, &first_block, &last_block);
+    for (cur_block = first_block;  cur_block && (cur_block <= last_block);  cur_block++)
+    {
+       if (journal_state[cur_block] == JOURNAL_STARTED)
+       {
+          // Interrupted Mid Block - Finished, Still Blank, Or Erase It Again
+          block_start = sflash_block_start(cur_block);
+          block_end   = block_start + sflash_block_size(cur_block);
+          if (block_start < start)  block_start = start;
+          if (block_end > end)      block_end = end;
+          words   = (block_end - block_start) / 4;
+          current = realloc(current, words * sizeof(unsigned int));
+          if (current == NULL)
+          {
+             fprintf(stderr,"Could not allocate %d bytes for block check\n", words * 4);
+             exit(1);
+          }
+          sflash_reset();
+          ejtag_read_block(block_start, current, words);
+
+          printf("Checking block %d (addr = %08x) left part programmed...", cur_block, block_start);
+          if (memcmp(current, image + ((block_start - start) / 4), words * 4) == 0)
+          {
+             journal_state[cur_block] = JOURNAL_DONE;
+             printf("Complete\n");
+          }
+          else if (image_blank(current, words))
+          {
+             journal_state[cur_block] = JOURNAL_ERASED;
+             printf("Blank\n");
+          }
+          else
+          {
+             journal_state[cur_block] = 0;
+             printf("Will be erased again\n");
+          }
+       }
+
+       if (journal_state[cur_block] == JOURNAL_DONE)  journal_done_blocks++;
+       if (journal_state[cur_block] == JOURNAL_ERASED)  erased++;
+       if (!journal_state[cur_block])  redo++;
+
+       // Done Or Already Erased - Nothing Left To Erase
+       if (journal_state[cur_block])  erase_skip[cur_block] = 1;
+    }
+    free(current);
+
+    printf("Resume: %d block(s) done, %d erased and waiting, %d still to erase\n\n", journal_done_blocks, erased, redo);
+}
+
+
+void journal_close(int complete)
+{
+    if (journal_fd)
+    {
+       fclose(journal_fd);
+       journal_fd = NULL;
+
+       if (complete)  remove(journal_name);
+       else printf("Journal kept in %s - run again with /resume to carry on\n", journal_name);
+    }
+
+    free(journal_state);
+    journal_state = NULL;
+    journal_done_blocks = 0;
+}
+
+
+// **************************************************************************
+// Sparse Backups
+//
+// Only non-blank blocks are stored, each PackBits compressed, behind a table
+// of every block in the area (address, size, hash, file offset) so any one
+// block can be read without the rest.  The hashes let /diff decide which
+// blocks an image changes without reading the flash again.
+// **************************************************************************
+
+unsigned int packbits_encode(unsigned char *in, unsigned int len, unsigned char *out)
+{
+    unsigned int i = 0, o = 0, run, lit;
+
+    while (i < len)
+    {
+       // Run Of Three Or More - Count Byte Then The Byte
+       for (run = 1; ((i + run) < len) && (run < 128) && (in[i + run] == in[i]); run++);
+       if (run >= 3)
+       {
+          out[o++] = (unsigned char)(257 - run);
+          out[o++] = in[i];
+          i += run;
+          continue;
+       }
+
+       // Literals Up To The Next Run Of Three
+       for (lit = 0; ((i + lit) < len) && (lit < 128); lit++)
+          if (((i + lit + 2) < len) && (in[i + lit] == in[i + lit + 1]) && (in[i + lit] == in[i + lit + 2]))  break;
+       out[o++] = (unsigned char)(lit - 1);
+       memcpy(out + o, in + i, lit);
+       o += lit;
+       i += lit;
+    }
+
+    return o;
+}
+
+
+unsigned int packbits_decode(unsigned char *in, unsigned int stored, unsigned char *out, unsigned int len)
+{
+    unsigned int i = 0, o = 0, n;
+
+    while ((i < stored) && (o < len))
+    {
+       n = in[i++];
+       if (n < 128)
+       {
+          n++;
+          if (((i + n) > stored) || ((o + n) > len))  break;
+          memcpy(out + o, in + i, n);
+          i += n;
+       }
+       else if (n > 128)
+       {
+          n = 257 - n;
+          if ((i >= stored) || ((o + n) > len))  break;
+          memset(out + o, in[i++], n);
+       }
+       else continue;
+       o += n;
+    }
+
+    return o;
+}
+
+
+unsigned int sparse_save(char *filename, unsigned int *image, unsigned int start, unsigned int length)
+{
+    sparse_header_type header;
+    sparse_block_type *table;
+    unsigned char *packed;
+    unsigned int end = start + length;
+    unsigned int addr, offset, largest = 0;
+    int count = 0, blanks = 0, i;
+    FILE *fd;
+
+    // Block Map Clipped To The Area (outside the map it is one block)
+    for (addr = start; addr < end; addr = sflash_block_end(addr, end))
+    {
+       if ((sflash_block_end(addr, end) - addr) > largest)  largest = sflash_block_end(addr, end) - addr;
+       count++;
+    }
+
+    table  = calloc(count + 1, sizeof(sparse_block_type));
+    packed = malloc(largest + (largest / 128) + 2);
+    if ((table == NULL) || (packed == NULL))
+    {
+       fprintf(stderr,"Could not allocate %d bytes for %s\n", largest, filename);
+       exit(1);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SPARSE_MAGIC, sizeof(header.magic));
+    header.version     = SPARSE_VERSION;
+    header.vendid      = vendid;
+    header.devid       = devid;
+    header.window      = FLASH_MEMORY_START;
+    header.flash_size  = flash_size;
+    header.start       = start;
+    header.length      = length;
+    header.block_count = count;
+    header.flags       = bigendianfile ? SPARSE_SWAPPED : 0;
+    sprintf(header.part, "%.63s", flash_part);
+
+    fd = fopen(filename, "wb");
+    if (fd == NULL)
+    {
+       fprintf(stderr,"Could not open %s for writing\n", filename);
+       exit(1);
+    }
+
+    // Data Goes After The Table, Which Is Written Once It Is Filled In
+    offset = sizeof(header) + (count * sizeof(sparse_block_type));
+    fseek(fd, offset, SEEK_SET);
+
+    for (i = 0, addr = start; i < count; i++, addr = sflash_block_end(addr, end))
+    {
+       table[i].addr = addr;
+       table[i].size = sflash_block_end(addr, end) - addr;
+       table[i].hash = image_hash(image + ((addr - start) / 4), table[i].size / 4);
+
+       if (image_blank(image + ((addr - start) / 4), table[i].size / 4))
+       {
+          blanks++;
+          continue;
+       }
+
+       // Kept As Is When Packing Does Not Make It Smaller
+       table[i].offset = offset;
+       table[i].stored = packbits_encode((unsigned char *)(image + ((addr - start) / 4)), table[i].size, packed);
+       if (table[i].stored >= table[i].size)
+       {
+          table[i].stored = table[i].size;
+          memcpy(packed, image + ((addr - start) / 4), table[i].size);
+       }
+       if (fwrite(packed, 1, table[i].stored, fd) != table[i].stored)
+       {
+          fprintf(stderr,"Could not write %s\n", filename);
+          exit(1);
+       }
+       offset += table[i].stored;
+    }
+
+    fseek(fd, 0, SEEK_SET);
+    if ((fwrite(&header, sizeof(header), 1, fd) != 1) || (fwrite(table, sizeof(sparse_block_type), count, fd) != (size_t)count))
+    {
+       fprintf(stderr,"Could not write %s\n", filename);
+       exit(1);
+    }
+    fclose(fd);
+
+    printf("Sparse Backup: %d blocks, %d blank (not stored), %d of %d bytes on disk\n", count, blanks, offset, length);
+
+    free(packed);
+    free(table);
+    return offset;
+}
+
+
+int sparse_load(char *filename)
+{
+    sparse_block_type *blk;
+    unsigned int i, next, file_size;
+
+    sparse_close();
+
+    sparse_fd = fopen(filename, "rb");
+    if (sparse_fd == NULL)
+    {
+       fprintf(stderr,"Could not open %s for reading\n", filename);
+       exit(1);
+    }
+
+    if ((fread(&sparse_header, sizeof(sparse_header), 1, sparse_fd) != 1) ||
+        (memcmp(sparse_header.magic, SPARSE_MAGIC, sizeof(sparse_header.magic)) != 0) ||
+        (sparse_header.version != SPARSE_VERSION))
+    {
+       fprintf(stderr,"%s is not a sparse backup\n", filename);
+       exit(1);
+    }
+    sparse_header.part[sizeof(sparse_header.part) - 1] = 0;   // Printed with %s - the file may not end it
+
+    fseek(sparse_fd, 0, SEEK_END);
+    file_size = ftell(sparse_fd);
+    fseek(sparse_fd, sizeof(sparse_header), SEEK_SET);
+
+    // Every Block Holds At Least A Word - More Entries Than That Is A Bad Header
+    if ((sparse_header.start & 3) || (sparse_header.length & 3) ||
+        ((sparse_header.start + sparse_header.length) < sparse_header.start) ||
+        (sparse_header.block_count > (sparse_header.length / 4)) ||
+        (sparse_header.block_count > ((file_size - sizeof(sparse_header)) / sizeof(sparse_block_type))))
+    {
+       fprintf(stderr,"%s has a bad header\n", filename);
+       exit(1);
+    }
+
+    sparse_blocks = malloc((sparse_header.block_count + 1) * sizeof(sparse_block_type));
+    if ((sparse_blocks == NULL) ||
+        (fread(sparse_blocks, sizeof(sparse_block_type), sparse_header.block_count, sparse_fd) != sparse_header.block_count))
+    {
+       fprintf(stderr,"Could not read the block table of %s\n", filename);
+       exit(1);
+    }
+
+    // Export & /basis Write Into Buffers Sized From The Header - Every Entry Must Fit It
+    next = sparse_header.start;
+    for (i = 0; i < sparse_header.block_count; i++)
+    {
+       blk = &sparse_blocks[i];
+       if ((blk->addr < next) || (blk->addr >= (sparse_header.start + sparse_header.length)) ||
+           (blk->addr & 3) || !blk->size || (blk->size & 3) ||
+           (blk->size > ((sparse_header.start + sparse_header.length) - blk->addr)) ||
+           (blk->offset && ((blk->stored > blk->size) || (blk->offset > file_size) || (blk->stored > (file_size - blk->offset)))))
+       {
+          fprintf(stderr,"%s has a bad block table (entry %d, addr = %08x)\n", filename, i, blk->addr);
+          exit(1);
+       }
+       next = blk->addr + blk->size;
+    }
+
+    return sparse_header.block_count;
+}
+
+
+sparse_block_type* sparse_find(unsigned int addr, unsigned int size)
+{
+    int lo = 0, hi, mid;
+
+    if (!sparse_blocks)  return NULL;
+
+    // Table Is In Address Order
+    hi = sparse_header.block_count - 1;
+    while (lo <= hi)
+    {
+       mid = (lo + hi) / 2;
+       if (sparse_blocks[mid].addr == addr)  return (sparse_blocks[mid].size == size) ? &sparse_blocks[mid] : NULL;
+       if (sparse_blocks[mid].addr < addr)  lo = mid + 1;
+       else hi = mid - 1;
+    }
+
+    return NULL;
+}
+
+
+int sparse_read_block(sparse_block_type *blk, unsigned int *data)
+{
+    unsigned char *packed;
+    unsigned int got;
+
+    if (!blk->offset)  memset(data, 0xFF, blk->size);
+    else
+    {
+       packed = malloc(blk->stored + 1);
+       if (packed == NULL)
+       {
+          fprintf(stderr,"Could not allocate %d bytes for block read\n", blk->stored);
+          exit(1);
+       }
+       got = 0;
+       if ((fseek(sparse_fd, blk->offset, SEEK_SET) == 0) && (fread(packed, 1, blk->stored, sparse_fd) == blk->stored))
+       {
+          if (blk->stored == blk->size)  memcpy(data, packed, got = blk->size);
+          else got = packbits_decode(packed, blk->stored, (unsigned char *)data, blk->size);
+       }
+       free(packed);
+       if (got != blk->size)  return 0;
+    }
+
+    // Good Only If It Still Hashes The Same
+    return (image_hash(data, blk->size / 4) == blk->hash);
+}
+
+
+void sparse_close(void)
+{
+    if (sparse_fd)  fclose(sparse_fd);
+    sparse_fd = NULL;
+    free(sparse_blocks);
+    sparse_blocks = NULL;
+}
+
+
+void run_export(char *filename)
+{
+    image_file_type raw;
+    unsigned int *image;
+    unsigned int i, len, bad = 0, blanks = 0;
+    char newfilename[160];
+
+    printf("*** You Selected to Export %s to a Raw Backup ***\n\n", filename);
+
+    sparse_load(filename);
+
+    // Name Of The Raw Backup It Stands For, Where It Has One
+    strcpy(newfilename, filename);
+    len = strlen(newfilename);
+    if ((len > 7) && (strcasecmp(newfilename + len - 7, ".SPARSE") == 0))  newfilename[len - 7] = 0;
+    else strcat(newfilename, ".RAW");
+
+    printf("%s: %s, %08x-%08x, %d blocks\n\n", filename, sparse_header.part,
+           sparse_header.start, sparse_header.start + sparse_header.length, sparse_header.block_count);
+
+    image = (unsigned int *) image_open(&raw, newfilename, sparse_header.length, 1);
+    for (i = 0; i < sparse_header.block_count; i++)
+    {
+       if (!sparse_blocks[i].offset)  blanks++;
+       if (!sparse_read_block(&sparse_blocks[i], image + ((sparse_blocks[i].addr - sparse_header.start) / 4)))
+       {
+          printf("*** Block at %08x does not match its hash ***\n", sparse_blocks[i].addr);
+          bad++;
+       }
+    }
+    if (sparse_header.flags & SPARSE_SWAPPED)  image_swap(image, sparse_header.length / 4);
+    image_close(&raw);
+    sparse_close();
+
+    printf("Done  (%s written, %d bytes, %d blank blocks filled in", newfilename, sparse_header.length, blanks);
+    if (bad)  printf(", %d BAD block(s)", bad);
+    printf(")\n");
+}
+
+
+int sparse_basis(char *filename)
+{
+    sparse_load(filename);
+
+    // Hashes Only Mean Something For The Same Chip
+    if ((sparse_header.vendid != vendid) || (sparse_header.devid != devid) || (sparse_header.window != FLASH_MEMORY_START))
+    {
+       printf("*** %s is from another flash (%s) - reading the flash instead ***\n\n", filename, sparse_header.part);
+       sparse_close();
+       return 0;
+    }
+
+    printf("Basis: %s (%08x-%08x) stands in for the flash contents\n\n", filename,
+           sparse_header.start, sparse_header.start + sparse_header.length);
+    return 1;
+}
+
+
+void run_backup(char *filename, unsigned int start, unsigned int length)
+{
+    image_file_type backup;
+    unsigned int *image;
+    unsigned int addr, count, saved_to;
+    unsigned int written = length;
+    char newfilename[128] = "";
+    char journalname[140];
+    FILE *fd;
+    int resumed;
+    time_t start_time = time(0);
+    time_t end_time, elapsed_seconds;
+
+    struct tm* lt = localtime(&start_time);
+    char time_str[15];
+    
+    sprintf(time_str, "%04d%02d%02d_%02d%02d%02d",
+        lt->tm_year + 1900, lt->tm_mon + 1, lt->tm_mday,
+        lt->tm_hour, lt->tm_min, lt->tm_sec
+    );
+
+    printf("*** You Selected to Backup the %s ***\n\n",filename);
+
+    strcpy(newfilename,filename);
+    strcat(newfilename,".SAVED");
+    if (issue_timestamp)
+    {
+       strcat(newfilename,"_");
+       strcat(newfilename,time_str);
+    }
+    if (backup_sparse)  strcat(newfilename,".SPARSE");
+
+    // Journal Name Leaves Out The Timestamp So The Next Run Can Find It
+    // (sparse backups are only written at the end - nothing to resume)
+    sprintf(journalname, "%s.SAVED", filename);
+    resumed = backup_sparse ? 0 : journal_open(journalname, "backup", newfilename, start, length, 0);
+    if (resumed)
+    {
+       strcpy(newfilename, journal_file);
+       if ((fd = fopen(newfilename, "rb")) != NULL)  fclose(fd);
+       else
+       {
+          printf("%s is gone - starting from the beginning\n", newfilename);
+          journal_resume_addr = start;
+       }
+    }
+
+    if (backup_sparse)
+    {
+       // Held In Memory - Blocks Are Hashed & Packed Once It Is All Read
+       memset(&backup, 0, sizeof(backup));
+       image = malloc(length + 4);
+       if (image == NULL)
+       {
+          fprintf(stderr,"Could not allocate %d bytes for %s\n", length, newfilename);
+          exit(1);
+       }
+    }
+    else image = (unsigned int *) image_open(&backup, newfilename, length, resumed ? 2 : 1);
+
+    // Only A Mapped File Is On Disk Before It Is Closed
+    if (!backup.mapped)
+    {
+       journal_close(1);
+       journal_resume_addr = start;
+    }
+
+    printf("=========================\n");
+    printf("Backup Routine Started\n");
+    printf("=========================\n");
+
+    printf("\nSaving %s to Disk...\n",newfilename);
+    progress_start("Backed Up", length, 0);
+    progress_swap = bigendianfile && !backup_sparse;   // Sparse blocks are swapped on export
+
+    saved_to = journal_resume_addr;
+    if (saved_to > start)
+    {
+       printf("Resuming at %08x (%d bytes already saved)\n", saved_to, saved_to - start);
+       progress_advance(saved_to - start);
+    }
+
+    for (addr = saved_to; addr < (start + length); addr += count * 4)
+    {
+        count = (start + length - addr) / 4;
+        if (count > BLOCK_TRANSFER_WORDS)  count = BLOCK_TRANSFER_WORDS;
+
+        // Straight Into The File's Pages
+        ejtag_read_block(addr, image + ((addr - start) / 4), count);
+        show_progress("Backed Up", addr, image + ((addr - start) / 4), count);
+
+        // Now And Then - Swapped Words Flushed To Disk, Then Noted In The Journal
+        if (journal_fd && ((get_seconds() - journal_synced) >= JOURNAL_SYNC_INTERVAL))
+        {
+           progress_flush();
+           image_sync(&backup);
+           journal_note("read", saved_to, addr + (count * 4), 1);
+           saved_to = addr + (count * 4);
+        }
+    }
+    progress_end();
+    if (backup_sparse)
+    {
+       written = sparse_save(newfilename, image, start, length);
+       free(image);
+    }
+    else image_close(&backup);
+    journal_close(1);
+
+    printf("Done  (%s saved to Disk OK)\n\n",newfilename);
+
+    printf("bytes written: %d\n", written);
+    
+    printf("=========================\n");
+    printf("Backup Routine Complete\n");
+    printf("=========================\n");
+
+    time(&end_time);
+    elapsed_seconds = difftime(end_time, start_time); 
+    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+}
+
+
+
+// **************************************************************************
+// Image Formats
+//
+// ELF, Intel HEX, Motorola S-record and TRX files are read as a stream into
+// an area sized buffer, noting each run of bytes the file really gives as an
+// address tagged segment.  Only blocks a segment touches are erased and
+// programmed; bytes of those blocks the file leaves out are read back from
+// the flash first so they stay as they were.  Anything else is a raw image
+// covering the whole area, as before.
+// **************************************************************************
+
+int image_format(char *filename)
+{
+    unsigned char magic[4] = { 0, 0, 0, 0 };
+    FILE *fd;
+
+    fd = fopen(filename, "rb");
+    if (fd == NULL)
+    {
+       fprintf(stderr,"Could not open %s for reading\n", filename);
+       exit(1);
+    }
+    fread(magic, 1, sizeof(magic), fd);
+    fclose(fd);
+
+    if (memcmp(magic, "\177ELF", 4) == 0)                  return IMAGE_ELF;
+    if (memcmp(magic, "HDR0", 4) == 0)                      return IMAGE_TRX;
+    if (magic[0] == ':')                                    return IMAGE_IHEX;
+    if ((magic[0] == 'S') && isdigit(magic[1]))             return IMAGE_SREC;
+    return IMAGE_RAW;
+}
+
+
+void image_put(unsigned int addr, unsigned char *data, unsigned int len)
+{
+    unsigned int end = image_area_start + image_area_length;
+    image_segment_type *last;
+
+    // KSEG0/KSEG1 To Physical
+    addr &= 0x1FFFFFFF;
+
+    // Clip To The Area
+    if (addr < image_area_start)
+    {
+       if ((image_area_start - addr) >= len)  {  image_outside += len;  return;  }
+       image_outside += image_area_start - addr;
+       data += image_area_start - addr;
+       len  -= image_area_start - addr;
+       addr  = image_area_start;
+    }
+    if (addr >= end)  {  image_outside += len;  return;  }
+    if ((addr + len) > end)
+    {
+       image_outside += (addr + len) - end;
+       len = end - addr;
+    }
+    if (!len)  return;
+
+    memcpy(image_area_data + (addr - image_area_start), data, len);
+
+    // Records Usually Follow On - Grow The Last Segment
+    last = image_segment_count ? &image_segments[image_segment_count - 1] : NULL;
+    if (last && ((last->addr + last->length) == addr))
+    {
+       last->length += len;
+       return;
+    }
+
+    if (image_segment_count == image_segment_max)
+    {
+       image_segment_max = image_segment_max ? (image_segment_max * 2) : 64;
+       image_segments = realloc(image_segments, image_segment_max * sizeof(image_segment_type));
+       if (image_segments == NULL)
+       {
+          fprintf(stderr,"Could not allocate the image segment list\n");
+          exit(1);
+       }
+    }
+    image_segments[image_segment_count].addr   = addr;
+    image_segments[image_segment_count].length = len;
+    image_segment_count++;
+}
+
+
+static void image_put_record(unsigned int addr, unsigned char *data, unsigned int len)
+{
+    // Only Asked For - A Linked Address Below The Area Length Would Land On Whatever Starts It
+    addr &= 0x1FFFFFFF;
+    if (image_offsets && (addr < image_area_start) && (addr < image_area_length))  addr += image_area_start;
+    image_put(addr, data, len);
+}
+
+
+static int image_hex_bytes(char *text, unsigned char *out, int count)
+{
+    unsigned int byte;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+       if (!isxdigit(text[i * 2]) || !isxdigit(text[i * 2 + 1]))  return 0;
+       sscanf(text + (i * 2), "%2x", &byte);
+       out[i] = (unsigned char)byte;
+    }
+    return 1;
+}
+
+
+static void image_parse_ihex(FILE *fd, char *filename)
+{
+    char line[600];
+    unsigned char rec[260];
+    unsigned int base = 0, sum;
+    int count, line_num = 0, i;
+
+    while (fgets(line, sizeof(line), fd))
+    {
+       line_num++;
+       if ((line[0] == '\r') || (line[0] == '\n') || (line[0] == 0))  continue;
+
+       // :LLAAAATT<data>CC - everything including the checksum adds up to 0
+       if ((line[0] != ':') || !image_hex_bytes(line + 1, rec, 1) ||
+           !image_hex_bytes(line + 1, rec, rec[0] + 5))
+       {
+          fprintf(stderr,"%s line %d: bad Intel HEX record\n", filename, line_num);
+          exit(1);
+       }
+       count = rec[0];
+       for (i = 0, sum = 0; i < (count + 5); i++)  sum += rec[i];
+       if (sum & 0xFF)
+       {
+          fprintf(stderr,"%s line %d: checksum error\n", filename, line_num);
+          exit(1);
+       }
+
+       switch (rec[3])
+       {
+          case 0x00:  image_put_record(base + ((rec[1] << 8) | rec[2]), rec + 4, count);  break;   // Data
+          case 0x01:  return;                                                                    // End Of File
+          case 0x02:  base = ((rec[4] << 8) | rec[5]) << 4;   break;                             // Extended Segment Address
+          case 0x04:  base = ((rec[4] << 8) | rec[5]) << 16;  break;                             // Extended Linear Address
+          default:    break;                                                                     // Start Addresses
+       }
+    }
+}
+
+
+static void image_parse_srec(FILE *fd, char *filename)
+{
+    char line[600];
+    unsigned char rec[260];
+    unsigned int addr, sum;
+    int count, alen, line_num = 0, i;
+
+    while (fgets(line, sizeof(line), fd))
+    {
+       line_num++;
+       if ((line[0] == '\r') || (line[0] == '\n') || (line[0] == 0))  continue;
+
+       // STLL<address><data>CC - count, address & data add up to 0xFF with the checksum
+       if ((line[0] != 'S') || !isdigit(line[1]) || !image_hex_bytes(line + 2, rec, 1) ||
+           !image_hex_bytes(line + 2, rec, rec[0] + 1))
+       {
+          fprintf(stderr,"%s line %d: bad S-record\n", filename, line_num);
+          exit(1);
+       }
+       count = rec[0];
+       for (i = 0, sum = 0; i <= count; i++)  sum += rec[i];
+       if ((sum & 0xFF) != 0xFF)
+       {
+          fprintf(stderr,"%s line %d: checksum error\n", filename, line_num);
+          exit(1);
+       }
+
+       // S1/S2/S3 Carry Data With 16/24/32 Bit Addresses - The Rest Are Headers, Counts & Starts
+       alen = line[1] - '0' + 1;
+       if ((alen < 2) || (alen > 4) || (count < (alen + 1)))  continue;
+       for (i = 0, addr = 0; i < alen; i++)  addr = (addr << 8) | rec[1 + i];
+       image_put_record(addr, rec + 1 + alen, count - alen - 1);
+    }
+}
+
+
+static void image_parse_elf(FILE *fd, char *filename)
+{
+    unsigned char eh[52], ph[32], chunk[0x10000];
+    unsigned int phoff, phentsize, phnum, offset, paddr, filesz, done, n, i;
+    int big;
+
+    if ((fread(eh, 1, sizeof(eh), fd) != sizeof(eh)) || (eh[4] != 1))
+    {
+       fprintf(stderr,"%s is not a 32 bit ELF file\n", filename);
+       exit(1);
+    }
+    big       = (eh[5] == 2);
+    phoff     = image_word(eh + 28, big);
+    phentsize = image_half(eh + 42, big);
+    phnum     = image_half(eh + 44, big);
+
+    for (i = 0; i < phnum; i++)
+    {
+       if ((fseek(fd, phoff + (i * phentsize), SEEK_SET) != 0) || (fread(ph, 1, sizeof(ph), fd) != sizeof(ph)))  break;
+       if (image_word(ph, big) != 1)  continue;   // PT_LOAD only
+
+       // Flash Gets The Load (physical) Address; .bss Has No File Bytes To Program
+       offset = image_word(ph + 4, big);
+       paddr  = image_word(ph + 12, big);
+       filesz = image_word(ph + 16, big);
+
+       // RAM Linked Segments Have No Place In Flash - Never Guess One
+       paddr &= 0x1FFFFFFF;
+       if (filesz && ((paddr < FLASH_MEMORY_START) || (paddr >= (FLASH_MEMORY_START + flash_size)) ||
+                      (filesz > ((FLASH_MEMORY_START + flash_size) - paddr))))
+       {
+          fprintf(stderr,"%s: ELF segment %d (%08x-%08x) is outside the flash (%08x-%08x)\n", filename, i,
+                  paddr, paddr + filesz, FLASH_MEMORY_START, FLASH_MEMORY_START + flash_size);
+          exit(1);
+       }
+
+       fseek(fd, offset, SEEK_SET);
+       for (done = 0; done < filesz; done += n)
+       {
+          n = ((filesz - done) < sizeof(chunk)) ? (filesz - done) : sizeof(chunk);
+          if (fread(chunk, 1, n, fd) != n)
+          {
+             fprintf(stderr,"ELF segment %d runs past the end of %s\n", i, filename);
+             exit(1);
+          }
+          image_put(paddr + done, chunk, n);
+       }
+    }
+}
+
+
+static void image_parse_trx(FILE *fd, char *filename)
+{
+    unsigned char chunk[0x10000];
+    unsigned int len, crc, file_crc, done, n, i;
+    int bit;
+
+    // Header: "HDR0", total length, CRC32 from offset 12 on, flags & partition offsets
+    if (fread(chunk, 1, 28, fd) != 28)
+    {
+       fprintf(stderr,"%s: short TRX header\n", filename);
+       exit(1);
+    }
+    len      = image_word(chunk + 4, 0);
+    file_crc = image_word(chunk + 8, 0);
+    if ((len < 28) || (len > image_area_length))
+    {
+       fprintf(stderr,"%s: TRX length %08x does not fit the %08x byte area\n", filename, len, image_area_length);
+       exit(1);
+    }
+
+    // Goes At The Start Of The Area, Only As Long As The Header Says
+    image_put(image_area_start, chunk, 28);
+    crc = 0xFFFFFFFF;
+    for (i = 12; i < 28; i++)
+    {
+       crc ^= chunk[i];
+       for (bit = 0; bit < 8; bit++)  crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+
+    for (done = 28; done < len; done += n)
+    {
+       n = ((len - done) < sizeof(chunk)) ? (len - done) : sizeof(chunk);
+       if (fread(chunk, 1, n, fd) != n)
+       {
+          fprintf(stderr,"%s: file is shorter than its TRX length\n", filename);
+          exit(1);
+       }
+       image_put(image_area_start + done, chunk, n);
+       for (i = 0; i < n; i++)
+       {
+          crc ^= chunk[i];
+          for (bit = 0; bit < 8; bit++)  crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+       }
+    }
+
+    if (crc != file_crc)
+       printf("*** %s: TRX CRC is %08x, header says %08x - image may be damaged ***\n", filename, crc, file_crc);
+}
+
+
+static int image_segment_order(const void *a, const void *b)
+{
+    const image_segment_type *sa = a, *sb = b;
+    return (sa->addr > sb->addr) - (sa->addr < sb->addr);
+}
+
+
+unsigned int* image_parse(char *filename, int format, unsigned int start, unsigned int length)
+{
+    static char *format_name[] = { "Raw", "ELF", "Intel HEX", "S-record", "TRX" };
+    unsigned int total = 0;
+    int i, j;
+    FILE *fd;
+
+    image_area_start    = start;
+    image_area_length   = length;
+    image_outside       = 0;
+    image_segment_count = 0;
+    image_area_data     = malloc(length + 4);
+    if (image_area_data == NULL)
+    {
+       fprintf(stderr,"Could not allocate %d bytes for %s\n", length, filename);
+       exit(1);
+    }
+    memset(image_area_data, 0xFF, length + 4);
+
+    fd = fopen(filename, (format == IMAGE_IHEX || format == IMAGE_SREC) ? "r" : "rb");
+    if (fd == NULL)
+    {
+       fprintf(stderr,"Could not open %s for reading\n", filename);
+       exit(1);
+    }
+    if (format == IMAGE_ELF)   image_parse_elf(fd, filename);
+    if (format == IMAGE_IHEX)  image_parse_ihex(fd, filename);
+    if (format == IMAGE_SREC)  image_parse_srec(fd, filename);
+    if (format == IMAGE_TRX)   image_parse_trx(fd, filename);
+    fclose(fd);
+
+    // Address Order, Overlapping Or Touching Runs Joined (later records already won in the buffer)
+    qsort(image_segments, image_segment_count, sizeof(image_segment_type), image_segment_order);
+    for (i = 0, j = -1; i < image_segment_count; i++)
+    {
+       if ((j >= 0) && (image_segments[i].addr <= (image_segments[j].addr + image_segments[j].length)))
+       {
+          if ((image_segments[i].addr + image_segments[i].length) > (image_segments[j].addr + image_segments[j].length))
+             image_segments[j].length = image_segments[i].addr + image_segments[i].length - image_segments[j].addr;
+          continue;
+       }
+       image_segments[++j] = image_segments[i];
+    }
+    image_segment_count = j + 1;
+
+    printf("%s: %s image, %d segment(s)\n", filename, format_name[format], image_segment_count);
+    for (i = 0; i < image_segment_count; i++)
+    {
+       if (i < MAX_SEGMENTS_SHOWN)
+          printf("    %08x-%08x  (%d bytes)\n", image_segments[i].addr, image_segments[i].addr + image_segments[i].length, image_segments[i].length);
+       total += image_segments[i].length;
+    }
+    if (image_segment_count > MAX_SEGMENTS_SHOWN)  printf("    ... %d more\n", image_segment_count - MAX_SEGMENTS_SHOWN);
+    printf("%d of %d bytes in the area given", total, length);
+    if (image_outside)  printf(", %d bytes outside it ignored", image_outside);
+    printf("\n\n");
+
+    if (!total)
+    {
+       fprintf(stderr,"%s has nothing for %08x-%08x\n", filename, start, start + length);
+       if (!image_offsets && ((format == IMAGE_IHEX) || (format == IMAGE_SREC)))
+          fprintf(stderr,"(use /offsets if its addresses count from the start of the area)\n");
+       exit(1);
+    }
+
+    return (unsigned int *) image_area_data;
+}
+
+
+static int image_segment_bytes(unsigned int addr, unsigned int end)
+{
+    unsigned int lo, hi, bytes = 0;
+    int i;
+
+    // Bytes Of [addr, end) The Image Gives
+    for (i = 0; i < image_segment_count; i++)
+    {
+       lo = (image_segments[i].addr > addr) ? image_segments[i].addr : addr;
+       hi = ((image_segments[i].addr + image_segments[i].length) < end) ? (image_segments[i].addr + image_segments[i].length) : end;
+       if (hi > lo)  bytes += hi - lo;
+    }
+    return bytes;
+}
+
+
+int image_fill_gaps(unsigned int start, unsigned int length)
+{
+    unsigned int *current = NULL;
+    unsigned int addr, blk_end, lo, hi, words;
+    unsigned int end = start + length;
+    int i, filled = 0;
+
+    for (addr = start; addr < end; addr = blk_end)
+    {
+       blk_end = sflash_block_end(addr, end);
+       if (!image_segment_bytes(addr, blk_end) || (image_segment_bytes(addr, blk_end) == (blk_end - addr)))  continue;
+
+       // Block Gets Erased - Bytes The Image Leaves Out Go Back As They Are Now
+       words   = (blk_end - addr) / 4;
+       current = realloc(current, words * sizeof(unsigned int));
+       if (current == NULL)
+       {
+          fprintf(stderr,"Could not allocate %d bytes for block fill\n", words * 4);
+          exit(1);
+       }
+       sflash_reset();
+       ejtag_read_block(addr, current, words);
+       if (bigendianfile)  image_swap(current, words);   // Buffer is still in file order
+
+       for (i = 0; i < image_segment_count; i++)
+       {
+          lo = (image_segments[i].addr > addr) ? image_segments[i].addr : addr;
+          hi = ((image_segments[i].addr + image_segments[i].length) < blk_end) ? (image_segments[i].addr + image_segments[i].length) : blk_end;
+          if (hi > lo)  memcpy((unsigned char *)current + (lo - addr), image_area_data + (lo - start), hi - lo);
+       }
+       memcpy(image_area_data + (addr - start), current, words * 4);
+       filled++;
+    }
+    free(current);
+
+    if (filled)  printf("%d partly covered block(s) filled in from flash\n\n", filled);
+    return filled;
+}
+
+
+int image_next_run(unsigned int start, unsigned int length, unsigned int *run_start, unsigned int *run_end)
+{
+    unsigned int end = start + length;
+    unsigned int addr = *run_start;
+
+    // Blocks The Image Does Not Touch Are Left Alone, Runs Of Ones It Does Are Flashed Together
+    while ((addr < end) && !image_segment_bytes(addr, sflash_block_end(addr, end)))  addr = sflash_block_end(addr, end);
+    if (addr >= end)  return 0;
+
+    *run_start = addr;
+    while ((addr < end) && image_segment_bytes(addr, sflash_block_end(addr, end)))  addr = sflash_block_end(addr, end);
+    *run_end = addr;
+    return 1;
+}
+
+
+void sflash_flash_area(char *filename, unsigned int *image, unsigned int start, unsigned int length)
+{
+    if (diff_mode)
+    {
+       sflash_diff_area(image, start, length);
+       return;
+    }
+
+    sflash_plan_area(image, start, length);
+    journal_apply(image, start, length);
+    if (sflash_dual_bank_ready(start, length))
+    {
+       printf("\nLoading %s to Flash Memory...\n",filename);
+       sflash_dual_bank_area(image, start, length);
+    }
+    else
+    {
+       if (issue_erase) sflash_erase_area(start,length);
+       memset(erase_skip, 0, block_total + 1);
+
+       printf("\nLoading %s to Flash Memory...\n",filename);
+       progress_start("Flashed", image_work(image, length / 4), 1);
+       sflash_program_range(start, image, length / 4);
+       progress_end();
+       progress_by_work = 0;
+    }
+}
+
+
+void run_flash(char *filename, unsigned int start, unsigned int length)
+{
+    image_file_type flash_image;
+    unsigned int *image;
+    unsigned int run_start, run_end;
+    int format, filled = 0;
+    time_t start_time = time(0);
+    time_t end_time, elapsed_seconds;
+
+    printf("*** You Selected to Flash the %s ***\n\n",filename);
+
+    // Whole Image Addressable At Once - Planning Looks At It Block By Block
+    format = image_format(filename);
+    if (format == IMAGE_RAW)
+       image = (unsigned int *) image_open(&flash_image, filename, length, 0);
+    else
+    {
+       // Parsed Into A Buffer Like A Short Raw Image (freed on close)
+       memset(&flash_image, 0, sizeof(flash_image));
+       image = image_parse(filename, format, start, length);
+       filled = image_fill_gaps(start, length);
+       flash_image.data   = (unsigned char *) image;
+       flash_image.length = length;
+    }
+    if (bigendianfile)  image_swap(image, length / 4);
+
+    // Differential Flashing Compares Every Block Anyway - Nothing To Journal
+    // (nor when bytes came from the flash - a resume could read them back erased)
+    if (!diff_mode && !filled)  journal_open(filename, "flash", filename, start, length, image_hash(image, length / 4));
+
+    printf("=========================\n");
+    printf("Flashing Routine Started\n");
+    printf("=========================\n");
+
+    verify_ok = verify_repaired = verify_failed = 0;
+
+    if (diff_mode && basis_file[0])  sparse_basis(basis_file);
+
+    if (format == IMAGE_RAW)
+       sflash_flash_area(filename, image, start, length);
+    else
+    {
+       for (run_start = start; image_next_run(start, length, &run_start, &run_end); run_start = run_end)
+       {
+          printf("Blocks %08x-%08x\n", run_start, run_end);
+          sflash_flash_area(filename, image + ((run_start - start) / 4), run_start, run_end - run_start);
+       }
+    }
+
+    sparse_close();
+    image_close(&flash_image);
+
+    // Blocks That Failed Verify Were Never Marked Done - A Resume Retries Them
+    journal_close(!verify_failed);
+
+    if (verify_ok || verify_repaired || verify_failed)
+       printf("\nVerify: %d block(s) verified, %d repaired, %d failed\n", verify_ok, verify_repaired, verify_failed);
+
+    if (verify_failed)
+       printf("*** %s NOT loaded correctly - %d block(s) failed verify ***\n\n", filename, verify_failed);
+    else
+       printf("Done  (%s loaded into Flash Memory OK)\n\n",filename);
+
+    sflash_reset();
+
+    printf("=========================\n");
+    printf("Flashing Routine Complete\n");
+    printf("=========================\n");
+
+    time(&end_time);
+    elapsed_seconds = difftime(end_time, start_time); 
+    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+}
+
+
+int progress_percent(void)
+{
+    if (!progress_total)  return 100;
+    return (int)(((double)progress_done * 100) / progress_total);
+}
+
+
+// ---- Console Side - Formatting, Rendering & File Swaps ----
+
+static void progress_write(void)
+{
+
+    // Hex Dump Goes Out In Large Blocks Instead Of A Line (or a word) At A Time
+    if (progress_text_len)
+    {
+       fwrite(progress_text, 1, progress_text_len, stdout);
+       progress_text_len = 0;
+    }
+
+}
+
+
+void progress_put(char *text)
+{
+    unsigned int len = strlen(text);
+
+    if ((progress_text_len + len) > sizeof(progress_text))  progress_write();
+    memcpy(progress_text + progress_text_len, text, len);
+    progress_text_len += len;
+}
+
+
+static void progress_report(double now, char *state)
+{
+    if (progress_stream)
+    {
+       fprintf(progress_stream, "progress action=%s done=%u total=%u percent=%d addr=%08x elapsed=%.1f state=%s\n",
+               progress_action, progress_done, progress_total, progress_percent(), progress_addr,
+               now - progress_started, state);
+       fflush(progress_stream);
+    }
+}
+
+
+void progress_render(int force)
+{
+    double now = get_seconds();
+
+    // Screen Updates At A Fixed Rate However Fast The Counters Move
+    if (!force && ((now - progress_last) < PROGRESS_INTERVAL))  return;
+    progress_last = now;
+
+    progress_write();
+    if (silent_mode)  printf("%4d%%   bytes = %d\r", progress_percent(), progress_done);
+    fflush(stdout);
+
+    progress_report(now, force ? "end" : "run");
+}
+
+
+static void progress_consume(progress_record_type *rec)
+{
+    unsigned int i, addr;
+    char line[64];
+
+    switch (rec->kind)
+    {
+       case PROGRESS_START:
+          // Counters Only Change Here - The Cable Side Never Touches Them
+          progress_action   = rec->action;
+          progress_done     = 0;
+          progress_total    = rec->count;
+          progress_addr     = 0;
+          progress_text_len = 0;
+          progress_started  = get_seconds();
+          progress_last     = 0;
+          progress_live     = 0;
+          return;
+
+       case PROGRESS_DUMP:
+          progress_action = rec->action;
+          for (i = 0, addr = rec->addr; i < rec->count; i++, addr += 4)
+          {
+             // Count Real Work When The Total Was Sized From The Image
+             progress_done += progress_by_work ? image_work(&rec->data[i], 1) : 4;
+             if (!silent_mode)
+             {
+                if ((addr&0xF) == 0)
+                {
+                   sprintf(line, "[%3d%% %s]   %08x: ", progress_percent(), rec->action, addr);
+                   progress_put(line);
+                }
+                sprintf(line, "%08x%c", rec->data[i], (addr&0xF)==0xC?'\n':' ');
+                progress_put(line);
+             }
+          }
+          // Words Shown As The CPU Sees Them, Saved As The File Wants Them
+          if (progress_swap)  image_swap(rec->data, rec->count);
+          progress_addr = addr;
+          progress_live = 1;
+          break;
+
+       case PROGRESS_SKIP:
+          if (!progress_by_work)  progress_done += rec->count;
+          if (!silent_mode)
+          {
+             sprintf(line, "[%3d%% Skipped]   %08x: blank to %08x\n", progress_percent(), rec->addr, rec->end);
+             progress_put(line);
+          }
+          progress_addr = rec->end;
+          progress_live = 1;
+          break;
+
+       case PROGRESS_ADVANCE:
+          progress_done += rec->count;
+          progress_live = 1;
+          break;
+
+       case PROGRESS_FLUSH:
+          progress_write();
+          fflush(stdout);
+          progress_live = 0;
+          return;
+
+       case PROGRESS_END:
+          progress_render(1);
+          if (silent_mode)  printf("\n");
+          fflush(stdout);
+          progress_live = 0;
+          return;
+    }
+
+    progress_render(0);
+}
+
+
+#ifndef WINDOWS_VERSION
+static void* progress_thread(void *arg)
+{
+    progress_record_type *rec;
+    double now;
+
+    while (1)
+    {
+       if (__atomic_load_n(&progress_head, __ATOMIC_ACQUIRE) != progress_tail)
+       {
+          rec = &progress_ring[progress_tail % PROGRESS_RING_SIZE];
+          progress_consume(rec);
+          __atomic_store_n(&progress_tail, progress_tail + 1, __ATOMIC_RELEASE);
+       }
+       else
+       {
+          // Nothing Queued - Keep /progress: Ticking While The Cable Is Busy
+          // (stdout is left alone, the cable side may be printing to it)
+          now = get_seconds();
+          if (progress_live && progress_stream && ((now - progress_last) >= PROGRESS_INTERVAL))
+          {
+             progress_last = now;
+             progress_report(now, "run");
+          }
+          usleep(1000);
+       }
+    }
+    return arg;
+}
+#endif
+
+
+// ---- Cable Side - Hands Everything Over Without Waiting On The Console ----
+
+static void progress_post(int kind, char *action, unsigned int addr, unsigned int end, unsigned int *data, unsigned int count)
+{
+    progress_record_type *rec;
+    progress_record_type serial_rec;
+
+    rec = progress_threaded ? &progress_ring[progress_head % PROGRESS_RING_SIZE] : &serial_rec;
+
+#ifndef WINDOWS_VERSION
+    // Ring Full - Console Is Behind, Give It A Moment
+    while (progress_threaded && ((progress_head - __atomic_load_n(&progress_tail, __ATOMIC_ACQUIRE)) >= PROGRESS_RING_SIZE))
+       sched_yield();
+#endif
+
+    rec->kind   = kind;
+    rec->action = action;
+    rec->addr   = addr;
+    rec->end    = end;
+    rec->data   = data;
+    rec->count  = count;
+
+    if (!progress_threaded)
+    {
+       progress_consume(rec);
+       return;
+    }
+
+#ifndef WINDOWS_VERSION
+    __atomic_store_n(&progress_head, progress_head + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+
+static void progress_drain(void)
+{
+#ifndef WINDOWS_VERSION
+    // Console Has Printed Everything Queued So Far
+    while (progress_threaded && (__atomic_load_n(&progress_tail, __ATOMIC_ACQUIRE) != progress_head))
+       sched_yield();
+#endif
+}
+
+
+void progress_start(char *action, unsigned int total, int by_work)
+{
+#ifndef WINDOWS_VERSION
+    pthread_t thread;
+
+    if (issue_threads && !progress_threaded)
+    {
+       if (pthread_create(&thread, NULL, progress_thread, NULL) == 0)
+       {
+          pthread_detach(thread);
+          progress_threaded = 1;
+       }
+    }
+#endif
+
+    // Set Before The Record Goes Out - Read By The Console Only For Later Records
+    progress_drain();
+    progress_by_work      = by_work;
+    progress_swap         = 0;
+    progress_cable_action = action;
+
+    progress_post(PROGRESS_START, action, 0, 0, NULL, total);
+}
+
+
+void progress_flush(void)
+{
+    // Anything Printed Straight Away Afterwards Lands After The Queued Output
+    progress_post(PROGRESS_FLUSH, progress_cable_action, 0, 0, NULL, 0);
+    progress_drain();
+}
+
+
+void progress_end(void)
+{
+    progress_post(PROGRESS_END, progress_cable_action, 0, 0, NULL, 0);
+    progress_drain();
+}
+
+
+void progress_skip(unsigned int addr, unsigned int end)
+{
+    progress_post(PROGRESS_SKIP, progress_cable_action, addr, end, NULL, end - addr);
+}
+
+
+void progress_advance(unsigned int bytes)
+{
+    progress_post(PROGRESS_ADVANCE, progress_cable_action, 0, 0, NULL, bytes);
+}
+
+
+void show_progress(char *action, unsigned int addr, unsigned int *data, unsigned int count)
+{
+    progress_post(PROGRESS_DUMP, action, addr, addr + (count * 4), data, count);
+}
+
+
+int sflash_program_range(unsigned int start, unsigned int *data, unsigned int words)
+{
+    unsigned int addr, chunk, count;
+    unsigned int end = start + (words * 4);
+    unsigned int blk_start, blk_end;
+    unsigned int *blk_data;
+    int blk_blank, blk_done, bad, fixed;
+    int blk_count = 0, blk_retried = 0, blk_failed = 0;
+    double blk_seconds, blk_min = 0, blk_max = 0, blk_sum = 0;
+
+    sflash_timing_model();
+    sflash_unlock_bypass(1);
+
+    if (issue_timing)
+    {
+       // Time Between Two Halfword Programs Is At Least One Unlock Sequence Of Link Accesses
+       skip_word_poll = (!flash_buffer_size && flash_prog_max &&
+                         ((link_latency_us * (unlock_bypass ? 2 : 4)) > flash_prog_max));
+       printf("Per-word polling %s (link %.1f us/access, chip program max %d us)\n\n",
+              skip_word_poll ? "skipped, verifying per block" : "kept", link_latency_us, flash_prog_max);
+    }
+
+    // Write Buffer parts get fed whole aligned buffers at a time, others a run of words
+    chunk = flash_buffer_size ? (flash_buffer_size / 4) : PROGRAM_RUN_WORDS;
+
+    blk_start   = start;
+    blk_data    = data;
+    blk_end     = sflash_block_end(start, end);
+    blk_blank   = image_blank(blk_data, (blk_end - blk_start) / 4);
+    blk_done    = journal_block_done(blk_start);
+    blk_seconds = get_seconds();
+
+    for (addr = start; addr < end; addr += (count * 4), data += count)
+    {
+        if (blk_done)
+        {
+           // Finished By An Earlier Run (/resume)
+           count = (blk_end - addr) / 4;
+           progress_advance(progress_by_work ? image_work(data, count) : count * 4);
+        }
+        else if (blk_blank)
+        {
+           // Programming 0xFF's Changes Nothing - Whole Block Left Out
+           count = (blk_end - addr) / 4;
+           progress_skip(addr, blk_end);
+        }
+        else
+        {
+           count = chunk - ((addr / 4) % chunk);
+           if (count > ((end - addr) / 4))  count = (end - addr) / 4;
+
+           // Flash Contents Uncertain From Here Until The Block Is Done
+           if (addr == blk_start)  journal_note("started", blk_start, blk_end, 1);
+
+           if (!image_blank(data, count))
+           {
+              if (flash_buffer_size)  sflash_write_buffer(addr, data, count);
+              else                    sflash_program_words(addr, data, count);
+           }
+
+           show_progress("Flashed", addr, data, count);
+        }
+
+        if ((addr + (count * 4)) < blk_end)  continue;
+
+        // Other Bank Erasing Meanwhile - Let It Run Again While This Block Reads Back
+        if (bg_erase_block)  sflash_erase_step(0);
+
+        if (!blk_blank && !blk_done)
+        {
+           // End of a Block - Read It Back While It Is Still Current
+           bad = 0;
+           if (issue_verify || skip_word_poll)
+           {
+              bad = sflash_check_block(blk_start, blk_data, (blk_end - blk_start) / 4, &fixed);
+              if (fixed)  blk_retried++;
+              if (bad)    blk_failed++;
+
+              // Chip Keeps Up With The Link After All - Go Back To Polling
+              if (skip_word_poll && (fixed > (int)((blk_end - blk_start) / 64)))
+              {
+                 skip_word_poll = 0;
+                 progress_flush();
+                 printf("Too many misses - per-word polling turned back on\n");
+              }
+           }
+
+           if (!bad)  journal_note("done", blk_start, blk_end, 0);
+
+           // Per Block Timings
+           blk_seconds = get_seconds() - blk_seconds;
+           if (!blk_count || (blk_seconds < blk_min))  blk_min = blk_seconds;
+           if (blk_seconds > blk_max)  blk_max = blk_seconds;
+           blk_sum += blk_seconds;
+           blk_count++;
+        }
+
+        blk_start   = blk_end;
+        blk_data    = data + count;
+        blk_end     = sflash_block_end(blk_start, end);
+        blk_blank   = image_blank(blk_data, (blk_end - blk_start) / 4);
+        blk_done    = journal_block_done(blk_start);
+        blk_seconds = get_seconds();
+    }
+
+    sflash_poll_pending();
+    sflash_unlock_bypass(0);
+    skip_word_poll = 0;
+    progress_flush();
+
+    if (issue_timing && blk_count)
+       printf("\nBlock timing: %d blocks, min %d ms, avg %d ms, max %d ms, %d re-programmed\n",
+              blk_count, (int)(blk_min * 1000), (int)((blk_sum / blk_count) * 1000), (int)(blk_max * 1000), blk_retried);
+
+    return blk_failed;
+}
+
+
+int image_blank(unsigned int *data, unsigned int words)
+{
+    unsigned int acc0 = 0xFFFFFFFF, acc1 = 0xFFFFFFFF, acc2 = 0xFFFFFFFF, acc3 = 0xFFFFFFFF;
+    unsigned int i;
+
+    // Four Independent Accumulators Let The Compiler Vectorise This
+    for (i = 0; (i + 4) <= words; i += 4)
+    {
+       acc0 &= data[i];
+       acc1 &= data[i + 1];
+       acc2 &= data[i + 2];
+       acc3 &= data[i + 3];
+    }
+    for (; i < words; i++)  acc0 &= data[i];
+
+    return ((acc0 & acc1 & acc2 & acc3) == 0xFFFFFFFF);
+}
+
+
+unsigned int image_work(unsigned int *data, unsigned int words)
+{
+    unsigned int bytes = 0;
+    unsigned int i;
+
+    // Bytes That Really Get Programmed (0xFFFF half words are skipped)
+    for (i = 0; i < words; i++)
+    {
+       if (data[i] == 0xFFFFFFFF)  continue;
+       if ((data[i] & 0xFFFF) != 0xFFFF)  bytes += 2;
+       if ((data[i] >> 16) != 0xFFFF)     bytes += 2;
+    }
+
+    return bytes;
+}
+
+
+void sflash_plan_area(unsigned int *image, unsigned int start, unsigned int length)
+{
+    unsigned int *current = NULL;
+    unsigned int block_start, block_end, words;
+    unsigned int end = start + length;
+    int cur_block, first_block, last_block;
+    int image_blanks = 0, flash_blanks = 0, tot_blocks = 0;
+
+    memset(erase_skip, 0, block_total + 1);
+
+    sflash_blocks_in(start, end, &first_block, &last_block);
+    for (cur_block = first_block;  cur_block <= last_block;  cur_block++)
+    {
+       block_start = sflash_block_start(cur_block);
+       block_end   = block_start + sflash_block_size(cur_block);
+       if (block_end > end)  block_end = end;
+       tot_blocks++;
+
+       if (!image_blank(image + ((block_start - start) / 4), (block_end - block_start) / 4))  continue;
+       image_blanks++;
+
+       if (!issue_erase)  continue;
+
+       // Blank In The Image - Only Worth Erasing If The Flash Is Not Blank Already
+       words   = (block_end - block_start) / 4;
+       current = realloc(current, words * sizeof(unsigned int));
+       if (current == NULL)
+       {
+          fprintf(stderr,"Could not allocate %d bytes for block check\n", words * 4);
+          exit(1);
+       }
+       sflash_reset();
+       ejtag_read_block(block_start, current, words);
+       if (image_blank(current, words))
+       {
+          erase_skip[cur_block] = 1;
+          flash_blanks++;
+       }
+    }
+
+    free(current);
+
+    printf("Image Analysis: %d blocks, %d blank in image", tot_blocks, image_blanks);
+    if (issue_erase)  printf(", %d already blank on flash", flash_blanks);
+    printf(", %d bytes to program\n\n", image_work(image, length / 4));
+}
+
+
+void run_erase(char *filename, unsigned int start, unsigned int length)
+{
+    time_t start_time = time(0);
+    time_t end_time, elapsed_seconds;
+
+    printf("*** You Selected to Erase the %s ***\n\n",filename);
+
+    printf("=========================\n");
+    printf("Erasing Routine Started\n");
+    printf("=========================\n");
+
+    sflash_erase_area(start,length);
+    sflash_reset();
+
+    printf("=========================\n");
+    printf("Erasing Routine Complete\n");
+    printf("=========================\n");
+
+    time(&end_time);
+    elapsed_seconds = difftime(end_time, start_time); 
+    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+}
+
+
+unsigned int image_word(unsigned char *p, int big)
+{
+    // Assemble a word the way the CPU will see these bytes in memory
+    if (big)  return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    else      return ((unsigned int)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+
+unsigned int image_half(unsigned char *p, int big)
+{
+    if (big)  return (p[0] << 8) | p[1];
+    else      return (p[1] << 8) | p[0];
+}
+
+
+void load_segment(unsigned char *image, unsigned int addr, unsigned int filesz, unsigned int memsz, int big)
+{
+    unsigned int buffer[BLOCK_TRANSFER_WORDS];
+    unsigned int offset, count, i;
+    unsigned char tail[4];
+
+    printf("Loading %08x bytes at %08x (%08x bytes zeroed) ...\n", filesz, addr, memsz > filesz ? memsz - filesz : 0);
+
+    if (memsz < filesz)  memsz = filesz;
+    memsz = (memsz + 3) & ~3;
+
+    for (offset = 0; offset < memsz; offset += count * 4)
+    {
+        count = (memsz - offset) / 4;
+        if (count > BLOCK_TRANSFER_WORDS)  count = BLOCK_TRANSFER_WORDS;
+
+        for (i = 0; i < count; i++)
+        {
+            unsigned int pos = offset + (i * 4);
+
+            if (pos + 4 <= filesz)  buffer[i] = image_word(image + pos, big);
+            else if (pos < filesz)
+            {
+                // Partial last word of the file, pad with zeros
+                memset(tail, 0, sizeof(tail));
+                memcpy(tail, image + pos, filesz - pos);
+                buffer[i] = image_word(tail, big);
+            }
+            else  buffer[i] = 0;  // BSS
+        }
+
+        // Write around the caches, stale lines are dropped once the image is in
+        ejtag_write_block((addr & 0x1FFFFFFF) + offset, buffer, count);
+
+        printf("%4d%%   bytes = %d\r", (int)(((double)(offset + count * 4) * 100) / memsz), offset + count * 4);
+        fflush(stdout);
+    }
+    printf("\n");
+
+    ejtag_pracc_cache_sync(addr, memsz);
+}
+
+
+void run_load(char *filename, unsigned int load_addr, unsigned int entry)
+{
+    image_file_type load_image;
+    unsigned char *image;
+    unsigned int image_size;
+    unsigned int total = 0;
+    double start_seconds, elapsed;
+    int big = bigendian;
+    time_t start_time = time(0);
+    time_t end_time, elapsed_seconds;
+
+    printf("*** You Selected to Load and Execute %s ***\n\n",filename);
+
+    // Cache Sync & Resume Are PrAcc Modules - They Would Wait Forever On A Running CPU
+    if (!debug_mode)
+    {
+       fprintf(stderr,"*** -load needs the processor in debug mode (drop /nobreak) ***\n");
+       chip_shutdown();
+       exit(1);
+    }
+
+    image      = image_open(&load_image, filename, 0, 0);
+    image_size = load_image.length;
+
+    printf("=========================\n");
+    printf("Load Routine Started\n");
+    printf("=========================\n\n");
+
+    start_seconds = get_seconds();
+
+    if ((image_size >= 52) && (memcmp(image, "\177ELF", 4) == 0) && (image[4] == 1))
+    {
+        // ELF32 - Load each PT_LOAD Program Header, Entry Point from the Header
+        unsigned int phoff, phentsize, phnum, i;
+
+        big = (image[5] == 2);
+        if (big != bigendian)
+           printf("*** Warning: ELF is %s endian but CPU is set to %s endian ***\n",
+                  big ? "big" : "little", bigendian ? "big" : "little");
+
+        if (!entry_given)  entry = image_word(image + 24, big);
+        phoff     = image_word(image + 28, big);
+        phentsize = image_half(image + 42, big);
+        phnum     = image_half(image + 44, big);
+
+        // Whole Table Inside The File (both halves are 16 bits - the product cannot wrap)
+        if ((phentsize < 32) || (phoff > image_size) || ((phnum * phentsize) > (image_size - phoff)))
+        {
+            fprintf(stderr,"%s has a bad ELF program header table\n", filename);
+            chip_shutdown();
+            exit(1);
+        }
+
+        for (i = 0; i < phnum; i++)
+        {
+            unsigned char *ph = image + phoff + (i * phentsize);
+            unsigned int offset, vaddr, filesz, memsz;
+
+            if (image_word(ph, big) != 1)  continue;   // PT_LOAD only
+
+            offset = image_word(ph + 4, big);
+            vaddr  = image_word(ph + 8, big);
+            filesz = image_word(ph + 16, big);
+            memsz  = image_word(ph + 20, big);
+            if ((offset > image_size) || (filesz > (image_size - offset)))
+            {
+                fprintf(stderr,"ELF segment %d runs past the end of %s\n", i, filename);
+                exit(1);
+            }
+
+            load_segment(image + offset, vaddr, filesz, memsz, big);
+            total += (memsz > filesz) ? memsz : filesz;
+        }
+    }
+    else
+    {
+        // Raw Image - Goes at the Load Address, Runs from the Load Address
+        if (!loadaddr_given)
+        {
+            fprintf(stderr,"Raw image %s needs a /loadaddr:XXXXXXXX option\n", filename);
+            exit(1);
+        }
+        if (!entry_given)  entry = load_addr;
+
+        load_segment(image, load_addr, image_size, image_size, big);
+        total += image_size;
+    }
+
+    image_close(&load_image);
+
+    elapsed = get_seconds() - start_seconds;
+    printf("Done  (%d bytes in %.2f seconds = %.0f bytes/sec)\n\n", total, elapsed, elapsed > 0 ? total / elapsed : 0);
+
+    printf("Starting Execution at %08x ... ", entry);
+    ejtag_pracc_resume(entry);
+    printf("Done\n\n");
+
+    printf("=========================\n");
+    printf("Load Routine Complete\n");
+    printf("=========================\n");
+
+    time(&end_time);
+    elapsed_seconds = difftime(end_time, start_time); 
+    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+}
+
+
+void run_dump(unsigned int start, unsigned int length)
+{
+    image_file_type dump;
+    unsigned int *image;
+    unsigned int addr, count;
+    char newfilename[128] = "";
+    double start_seconds, elapsed;
+    time_t start_time = time(0);
+    time_t end_time, elapsed_seconds;
+
+    struct tm* lt = localtime(&start_time);
+    char time_str[16];
+
+    strftime(time_str, sizeof(time_str), "%Y%m%d_%H%M%S", lt);
+
+    printf("*** You Selected to Dump Memory at %08x ***\n\n", start);
+
+    sprintf(newfilename, "MEMORY_%08X.BIN", start);
+    if (issue_timestamp)
+    {
+       strcat(newfilename,"_");
+       strcat(newfilename,time_str);
+    }
+
+    length = (length + 3) & ~3;
+    image  = (unsigned int *) image_open(&dump, newfilename, length, 1);
+
+    printf("=========================\n");
+    printf("Dump Routine Started\n");
+    printf("=========================\n");
+
+    printf("\nSaving %s to Disk...\n",newfilename);
+    start_seconds = get_seconds();
+
+    progress_start("Dumped", length, 0);
+    progress_swap = bigendianfile;
+    for (addr = start; addr < (start + length); addr += count * 4)
+    {
+        count = (start + length - addr) / 4;
+        if (count > BLOCK_TRANSFER_WORDS)  count = BLOCK_TRANSFER_WORDS;
+
+        ejtag_read_block(addr, image + ((addr - start) / 4), count);
+        show_progress("Dumped", addr, image + ((addr - start) / 4), count);
+    }
+    progress_end();
+    image_close(&dump);
+    elapsed = get_seconds() - start_seconds;
+
+    printf("Done  (%s saved to Disk OK)\n\n",newfilename);
+
+    printf("bytes written: %d (%.0f bytes/sec)\n", length, elapsed > 0 ? length / elapsed : 0);
+
+    printf("=========================\n");
+    printf("Dump Routine Complete\n");
+    printf("=========================\n");
+
+    time(&end_time);
+    elapsed_seconds = difftime(end_time, start_time); 
+    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+}
+
+
+void run_bwtest(unsigned int start, unsigned int length)
+{
+    unsigned int *buffer;
+    unsigned int count = (length + 3) / 4;
+    unsigned int i;
+    double start_seconds, elapsed;
+
+    printf("*** You Selected to Test Bandwidth at %08x (%d bytes per mode) ***\n\n", start, count * 4);
+
+    buffer = malloc(count * sizeof(unsigned int));
+    if (buffer == NULL)
+    {
+        fprintf(stderr,"Could not allocate %d bytes\n", count * 4);
+        exit(1);
+    }
+
+    printf("=========================\n");
+    printf("Bandwidth Test Started\n");
+    printf("=========================\n\n");
+
+    printf("    - DMA Word Reads ....... : ");  fflush(stdout);
+    if (DMA_SUPPORTED)
+    {
+       start_seconds = get_seconds();
+       for (i = 0; i < count; i++)  buffer[i] = ejtag_dma_read(start + i * 4);
+       elapsed = get_seconds() - start_seconds;
+       printf("%10.0f bytes/sec\n", elapsed > 0 ? (count * 4) / elapsed : 0);
+    }
+    else printf("Not Supported\n");
+
+    printf("    - PrAcc Word Reads ..... : ");  fflush(stdout);
+    start_seconds = get_seconds();
+    for (i = 0; i < count; i++)  buffer[i] = ejtag_pracc_read(start + i * 4);
+    elapsed = get_seconds() - start_seconds;
+    printf("%10.0f bytes/sec\n", elapsed > 0 ? (count * 4) / elapsed : 0);
+
+    printf("    - PrAcc Block Reads .... : ");  fflush(stdout);
+    start_seconds = get_seconds();
+    for (i = 0; i < count; i += BLOCK_TRANSFER_WORDS)
+       ejtag_pracc_read_block(start + i * 4, buffer + i, (count - i) < BLOCK_TRANSFER_WORDS ? (count - i) : BLOCK_TRANSFER_WORDS);
+    elapsed = get_seconds() - start_seconds;
+    printf("%10.0f bytes/sec\n", elapsed > 0 ? (count * 4) / elapsed : 0);
+
+    free(buffer);
+
+    printf("\n=========================\n");
+    printf("Bandwidth Test Complete\n");
+    printf("=========================\n");
+}
+
+
+void run_benchscan(void)
+{
+    unsigned char pins[SCAN_MAX_CLOCKS * 2], ref_pins[SCAN_MAX_CLOCKS * 2];
+    unsigned char *status;
+    unsigned int *words, ref_word, word, sum;
+    unsigned int i, n, bad = 0;
+    int k, tms, tdi, mode;
+    unsigned char data;
+    double start_seconds, elapsed, per_bit = 0;
+
+    printf("*** You Selected to Benchmark Scan Vector Expansion (%s cable, no target needed) ***\n\n", wiggler ? "wiggler" : "xilinx");
+
+    scan_setup();
+    words  = malloc(SCAN_BENCH_WORDS * sizeof(unsigned int));
+    status = malloc(SCAN_BENCH_WORDS * 32);
+    if ((words == NULL) || (status == NULL))
+    {
+        fprintf(stderr,"Could not allocate scan benchmark buffers\n");
+        exit(1);
+    }
+
+    // Made up TDI words and status samples, the same for every kernel
+    srand(1);
+    for (i = 0; i < SCAN_BENCH_WORDS; i++)  words[i] = ((unsigned int)rand() << 16) ^ (unsigned int)rand();
+    for (i = 0; i < SCAN_BENCH_WORDS * 32; i++)  status[i] = (unsigned char)rand();
+
+    printf("=========================\n");
+    printf("Scan Benchmark Started\n");
+    printf("=========================\n\n");
+
+    // The old clockin() arithmetic, one bit per loop with shifts & masks
+    printf("    - Per Bit Loop ......... : ");  fflush(stdout);
+    sum = 0;
+    start_seconds = get_seconds();
+    for (i = 0; i < SCAN_BENCH_WORDS; i++)
+    {
+       ref_word = 0;
+       for (k = 0; k < 32; k++)
+       {
+          tms = (k == 31);
+          tdi = (words[i] >> k) & 1;
+          if (wiggler) data = (1 << WTDO) | (0 << WTCK) | (tms << WTMS) | (tdi << WTDI) | (1 << WTRST_N);
+          else         data = (1 << TDO) | (0 << TCK) | (tms << TMS) | (tdi << TDI);
+          ref_pins[(k + 3) * 2] = data;
+          if (wiggler) data = (1 << WTDO) | (1 << WTCK) | (tms << WTMS) | (tdi << WTDI) | (1 << WTRST_N);
+          else         data = (1 << TDO) | (1 << TCK) | (tms << TMS) | (tdi << TDI);
+          ref_pins[(k + 3) * 2 + 1] = data;
+          data = status[i * 32 + k];
+          data ^= (1 << WTDO);
+          data >>= wiggler ? WTDO : TDO;
+          ref_word |= (unsigned int)(data & 1) << k;
+       }
+       sum += ref_word + ref_pins[(i & 31) * 2 + 6];
+    }
+    elapsed = get_seconds() - start_seconds;
+    if (elapsed > 0)  per_bit = elapsed;
+    printf("%10.1f Mbit/sec   (check %08x)\n", elapsed > 0 ? (SCAN_BENCH_WORDS * 32.0) / elapsed / 1000000.0 : 0, sum);
+
+    for (mode = 0; mode < 2; mode++)
+    {
+       #ifndef SCAN_SSE2
+       if (mode == 1)  {  printf("    - Table + SSE2 ......... : Not Built In\n");  break;  }
+       #endif
+       scan_simd = mode;
+       printf("    - Table %s : ", mode ? "+ SSE2 ........." : "Scalar .........");  fflush(stdout);
+       sum = 0;
+       start_seconds = get_seconds();
+       for (i = 0; i < SCAN_BENCH_WORDS; i++)
+       {
+          scan_expand(pins, (unsigned long long)words[i] << 3, SCAN_DR_TMS, 37);
+          word = scan_pack(status + i * 32, 32);
+          sum += word + pins[(i & 31) * 2 + 6];
+       }
+       elapsed = get_seconds() - start_seconds;
+       printf("%10.1f Mbit/sec   (check %08x", elapsed > 0 ? (SCAN_BENCH_WORDS * 32.0) / elapsed / 1000000.0 : 0, sum);
+       if ((elapsed > 0) && (per_bit > 0))  printf(", %.1fx", per_bit / elapsed);
+       printf(")\n");
+    }
+
+    // Both kernels against the per bit loop, pin for pin
+    for (mode = 0; mode < 2; mode++)
+    {
+       scan_simd = mode;
+       for (i = 0; i < 4096; i++)
+       {
+          n = i % SCAN_BENCH_WORDS;
+          scan_expand(pins, (unsigned long long)words[n] << 3, SCAN_DR_TMS, 37);
+          ref_word = 0;
+          for (k = 0; k < 37; k++)
+          {
+             tms = (k < 1) || (k >= 34 && k <= 35);
+             tdi = (k >= 3 && k < 35) ? (words[n] >> (k - 3)) & 1 : 0;
+             if (wiggler) data = (1 << WTDO) | (tms << WTMS) | (tdi << WTDI) | (1 << WTRST_N);
+             else         data = (1 << TDO) | (tms << TMS) | (tdi << TDI);
+             if ((pins[k * 2] != data) || (pins[k * 2 + 1] != (data | (1 << (wiggler ? WTCK : TCK)))))  bad++;
+          }
+          for (k = 0; k < 32; k++)
+             ref_word |= (unsigned int)((((status[n * 32 + k] ^ (1 << WTDO)) >> (wiggler ? WTDO : TDO))) & 1) << k;
+          if (scan_pack(status + n * 32, 32) != ref_word)  bad++;
+       }
+       #ifndef SCAN_SSE2
+       break;
+       #endif
+    }
+    #ifdef SCAN_SSE2
+    scan_simd = 1;
+    #endif
+
+    free(words);
+    free(status);
+
+    printf("\n    %s\n", bad ? "*** Kernels DISAGREE with the per bit loop ***" : "Kernels match the per bit loop");
+    printf("\n=========================\n");
+    printf("Scan Benchmark Complete\n");
+    printf("=========================\n");
+}
+
+
+void identify_flash_part(void)
+{
+   flash_chip_type*   flash_chip = flash_chip_list;
+   unsigned int       region_num[4], region_size[4];
+
+   // Important for these to initialize to zero
+   block_addr   = 0;
+   block_total  = 0;
+   region_total = 0;
+   flash_size  = 0;
+   flash_flags = 0;
+   flash_buffer_size = 0;
+   flash_prog_typ = flash_prog_max = 0;
+   flash_erase_typ = flash_erase_max = 0;
+   strcpy(flash_part,"");
+
+   // Funky AMD Chip
+   if (((vendid & 0x00ff) == 0x0001) && (devid == 0x227E))  devid = ejtag_read_h(FLASH_MEMORY_START + (0x0F << (flash_x32 ? 2 : 1)));  // Get real devid
+
+   //   printf("vendid: %x, devid: %x\n", vendid, devid);
+
+   while (flash_chip->vendid)
+   {
+      if ((flash_chip->vendid == vendid) && (flash_chip->devid == devid))
+      {
+         flash_size = flash_chip->flash_size;
+         sflash_select_driver(flash_chip->cmd_type);
+         flash_flags = flash_chip->flags;
+         if (issue_buffer && flash_driver->write_buffer)  flash_buffer_size = flash_chip->buffer_size;
+         flash_prog_typ  = flash_chip->prog_typ;
+         flash_prog_max  = flash_chip->prog_max;
+         flash_erase_typ = flash_chip->erase_typ;
+         flash_erase_max = flash_chip->erase_max;
+         strcpy(flash_part, flash_chip->flash_part);
+
+         region_num[0] = flash_chip->region1_num;  region_size[0] = flash_chip->region1_size;
+         region_num[1] = flash_chip->region2_num;  region_size[1] = flash_chip->region2_size;
+         region_num[2] = flash_chip->region3_num;  region_size[2] = flash_chip->region3_size;
+         region_num[3] = flash_chip->region4_num;  region_size[3] = flash_chip->region4_size;
+
+         sflash_setup_part(region_num, region_size, 4);
+         break;
+      }
+      flash_chip++;
+   }
+}
+
+
+void sflash_setup_part(unsigned int *region_num, unsigned int *region_size, int regions)
+{
+   flash_area_type*   flash_area = flash_area_list;
+   int i;
+
+   // Two Chips Side By Side - Twice The Size, Every Block Twice As Wide
+   if (flash_x32)  flash_size *= 2;
+
+   if (flash_size >= size8MB) FLASH_MEMORY_START = 0x1C000000;
+   else FLASH_MEMORY_START = 0x1FC00000;
+
+   while (flash_area->chip_size)
+   {
+      if ((flash_area->chip_size == flash_size) && (strcasecmp(flash_area->area_name, AREA_NAME)==0))
+      {
+         strcat(AREA_NAME,".BIN");
+         AREA_START  = flash_area->area_start;
+         AREA_LENGTH = flash_area->area_length;
+         break;
+      }
+      flash_area++;
+   }
+
+   if (strcasecmp(AREA_NAME,"CUSTOM")==0)
+   {
+      strcat(AREA_NAME,".BIN");
+      FLASH_MEMORY_START = selected_window;
+      AREA_START         = selected_start;
+      AREA_LENGTH        = selected_length;
+   }
+
+   // Nothing In The Area Table For Very Large Parts
+   if ((strcasecmp(AREA_NAME,"WHOLEFLASH")==0) && (flash_size > 0))
+   {
+      strcat(AREA_NAME,".BIN");
+      AREA_START  = FLASH_MEMORY_START;
+      AREA_LENGTH = flash_size;
+   }
+
+   dual_bank_split = 0;
+   for (i = 0; i < regions; i++)
+   {
+      if (region_num[i])  define_block(region_num[i], region_size[i] << flash_x32);
+
+      // Read-While-Write Parts - Second Bank Starts Where The Flagged Regions End
+      if ((flash_flags & FLAG_DUAL_BANK) && ((i + 1) == FLAG_BANK_REGIONS(flash_flags)))  dual_bank_split = block_addr;
+   }
+   flash_map_end = block_addr;
+   bank_current  = -1;
+
+   erase_skip = realloc(erase_skip, block_total + 1);
+   if (erase_skip == NULL)
+   {
+      fprintf(stderr,"Could not allocate %d bytes for the block map\n", block_total + 1);
+      exit(1);
+   }
+   memset(erase_skip, 0, block_total + 1);
+
+   sflash_reset();
+
+   printf("Done\n\n");
+   printf("Flash Vendor ID: ");  ShowData(vendid);
+   printf("Flash Device ID: ");  ShowData(devid);
+   if (selected_fc != 0)
+      printf("*** Manually Selected a %s Flash Chip ***\n\n", flash_part);
+   else
+      printf("*** Found a %s Flash Chip ***\n\n", flash_part);
+
+   printf("    - Flash Chip Window Start .... : %08x\n", FLASH_MEMORY_START);
+   printf("    - Flash Chip Window Length ... : %08x\n", flash_size);
+   printf("    - Selected Area Start ........ : %08x\n", AREA_START);
+   printf("    - Selected Area Length ....... : %08x\n", AREA_LENGTH);
+   if (dual_bank_split)
+      printf("    - Second Bank Start .......... : %08x\n", dual_bank_split);
+   if (flash_x32)
+      printf("    - Bus Width .................. : x32 (two x16 chips)\n");
+   printf("\n");
+}
+
+
+void sflash_cmd(unsigned int offset, unsigned int data)
+{
+
+   // Both Chips Of An x32 Pair Take The Command In One Write
+   if (flash_x32)  ejtag_write(FLASH_MEMORY_START + (offset << 2), data);
+   else            ejtag_write_h(FLASH_MEMORY_START + (offset << 1), data);
+
+}
+
+
+unsigned int sflash_cfi_byte(unsigned int offset)
+{
+   unsigned int data = ejtag_read_h(FLASH_MEMORY_START + (offset << (flash_x32 ? 2 : 1)));
+
+   // CFI Data Sits In The Low Byte Of Each x16 Word (unless the bus is swapped)
+   if (cfi_byte_swap)  return ((data >> 8) & 0xFF);
+   return (data & 0xFF);
+}
+
+
+unsigned int sflash_cfi_word(unsigned int offset)
+{
+   return (sflash_cfi_byte(offset) | (sflash_cfi_byte(offset + 1) << 8));
+}
+
+
+int sflash_cfi_query(void)
+{
+   flash_driver_type*  driver;
+   unsigned int ext, num, size, swap;
+   int i;
+
+   memset(&cfi_info, 0, sizeof(cfi_info));
+
+   // Read Array, Then CFI Query (98h at 55h suits every command set)
+   sflash_select_driver(CMD_TYPE_AMD);
+   sflash_reset();
+   sflash_cmd(0x55, 0x00980098);
+
+   for (cfi_byte_swap = 0; cfi_byte_swap < 2; cfi_byte_swap++)
+      if ((sflash_cfi_byte(0x10) == 'Q') && (sflash_cfi_byte(0x11) == 'R') && (sflash_cfi_byte(0x12) == 'Y'))  break;
+
+   if (cfi_byte_swap == 2)
+   {
+      cfi_byte_swap = 0;
+      sflash_reset();
+      return 0;
+   }
+
+   cfi_info.cmd_set = sflash_cfi_word(0x13);
+   for (driver = flash_driver_list; driver->cmd_type; driver++)
+      if (driver->cfi_cmd_set == cfi_info.cmd_set)  break;
+
+   // A Command Set We Cannot Drive (x32 pairs are AMD only)
+   if (!driver->cmd_type || (flash_x32 && (driver->cmd_type != CMD_TYPE_AMD)))
+   {
+      sflash_reset();
+      return 0;
+   }
+   sflash_select_driver(driver->cmd_type);
+
+   // Timeouts Are Powers Of Two (maximums are multiples of the typical)
+   cfi_info.prog_typ  = 1 << sflash_cfi_byte(0x1F);
+   cfi_info.prog_max  = cfi_info.prog_typ << sflash_cfi_byte(0x23);
+   cfi_info.erase_typ = 1 << sflash_cfi_byte(0x21);
+   cfi_info.erase_max = cfi_info.erase_typ << sflash_cfi_byte(0x25);
+
+   cfi_info.flash_size = 1 << sflash_cfi_byte(0x27);
+   if (sflash_cfi_byte(0x20))  cfi_info.buffer_size = 1 << sflash_cfi_word(0x2A);
+   if (cfi_info.buffer_size > MAX_WRITE_BUFFER)  cfi_info.buffer_size = MAX_WRITE_BUFFER;
+
+   cfi_info.regions = sflash_cfi_byte(0x2C);
+   if (cfi_info.regions == 0)
+   {
+      sflash_reset();
+      return 0;
+   }
+   if (cfi_info.regions > MAX_CFI_REGIONS)  cfi_info.regions = MAX_CFI_REGIONS;
+   for (i = 0; i < cfi_info.regions; i++)
+   {
+      num  = sflash_cfi_word(0x2D + (i * 4)) + 1;
+      size = sflash_cfi_word(0x2F + (i * 4)) * 256;
+      cfi_info.region_num[i]  = num;
+      cfi_info.region_size[i] = size ? size : 128;
+   }
+
+   // AMD Top Boot Parts May List Their Regions Bottom Up
+   if ((cmd_type == CMD_TYPE_AMD) && (cfi_info.regions > 1))
+   {
+      ext = sflash_cfi_word(0x15);
+      if ((sflash_cfi_byte(ext) == 'P') && (sflash_cfi_byte(ext + 1) == 'R') && (sflash_cfi_byte(ext + 2) == 'I') &&
+          (sflash_cfi_byte(ext + 0xF) == 3) && (cfi_info.region_size[0] < cfi_info.region_size[cfi_info.regions - 1]))
+      {
+         for (i = 0; i < (cfi_info.regions / 2); i++)
+         {
+            swap = cfi_info.region_num[i];
+            cfi_info.region_num[i] = cfi_info.region_num[cfi_info.regions - 1 - i];
+            cfi_info.region_num[cfi_info.regions - 1 - i] = swap;
+            swap = cfi_info.region_size[i];
+            cfi_info.region_size[i] = cfi_info.region_size[cfi_info.regions - 1 - i];
+            cfi_info.region_size[cfi_info.regions - 1 - i] = swap;
+         }
+      }
+   }
+
+   sflash_reset();
+   return 1;
+}
+
+
+void sflash_cfi_part(void)
+{
+
+   // Not In The Table - Take Everything From The CFI Data
+   block_addr   = 0;
+   block_total  = 0;
+   region_total = 0;
+   flash_size  = cfi_info.flash_size;
+   flash_flags = 0;
+   flash_buffer_size = 0;
+   if (issue_buffer && flash_driver->write_buffer)  flash_buffer_size = cfi_info.buffer_size;
+   flash_prog_typ  = cfi_info.prog_typ;
+   flash_prog_max  = cfi_info.prog_max;
+   flash_erase_typ = cfi_info.erase_typ;
+   flash_erase_max = cfi_info.erase_max;
+
+   sprintf(flash_part, "CFI %s %dx%d block(s) (%dMB)",
+           flash_driver->name,
+           cfi_info.region_num[cfi_info.regions - 1], cfi_info.region_size[cfi_info.regions - 1] / 1024, flash_size / size1MB);
+
+   sflash_setup_part(cfi_info.region_num, cfi_info.region_size, cfi_info.regions);
+}
+
+
+void define_block(unsigned int block_count, unsigned int block_size)
+{
+  flash_region_type*  region;
+
+  if (block_addr == 0)  block_addr = FLASH_MEMORY_START;
+
+  // Same Size As The Region Before - Just Grow It
+  region = region_total ? &flash_regions[region_total - 1] : NULL;
+  if ((region == NULL) || (region->block_size != block_size))
+  {
+     if (region_total == MAX_FLASH_REGIONS)
+     {
+        fprintf(stderr,"Too many flash regions (max %d)\n", MAX_FLASH_REGIONS);
+        return;
+     }
+     region = &flash_regions[region_total++];
+     region->start       = block_addr;
+     region->block_size  = block_size;
+     region->block_count = 0;
+     region->first_block = block_total + 1;
+  }
+
+  region->block_count += block_count;
+  block_total += block_count;
+  block_addr  += block_count * block_size;
+}
+
+
+int sflash_region_of_block(int block)
+{
+  int lo = 0, hi = region_total - 1, mid;
+
+  // Last Region Starting At Or Before This Block
+  while (lo < hi)
+  {
+     mid = (lo + hi + 1) / 2;
+     if (flash_regions[mid].first_block <= block)  lo = mid;
+     else hi = mid - 1;
+  }
+  return lo;
+}
+
+
+int sflash_region_of_addr(unsigned int addr)
+{
+  int lo = 0, hi = region_total - 1, mid;
+
+  // Last Region Starting At Or Before This Address
+  while (lo < hi)
+  {
+     mid = (lo + hi + 1) / 2;
+     if (flash_regions[mid].start <= addr)  lo = mid;
+     else hi = mid - 1;
+  }
+  return lo;
+}
+
+
+unsigned int sflash_block_start(int block)
+{
+  flash_region_type*  region = &flash_regions[sflash_region_of_block(block)];
+
+  return (region->start + ((block - region->first_block) * region->block_size));
+}
+
+
+unsigned int sflash_block_size(int block)
+{
+  return (flash_regions[sflash_region_of_block(block)].block_size);
+}
+
+
+int sflash_block_of(unsigned int addr)
+{
+  flash_region_type*  region;
+
+  if (!block_total || (addr < flash_regions[0].start) || (addr >= flash_map_end))  return 0;
+
+  region = &flash_regions[sflash_region_of_addr(addr)];
+  return (region->first_block + ((addr - region->start) / region->block_size));
+}
+
+
+int sflash_blocks_in(unsigned int start, unsigned int end, int *first, int *last)
+{
+
+  // Blocks Whose Start Lies In [start, end)
+  *first = 1;
+  *last  = 0;
+  if (!block_total || (end <= flash_regions[0].start) || (start >= flash_map_end))  return 0;
+
+  if (start > flash_regions[0].start)
+  {
+     *first = sflash_block_of(start);
+     if (sflash_block_start(*first) < start)  (*first)++;
+  }
+  *last = (end >= flash_map_end) ? block_total : sflash_block_of(end - 1);
+
+  return ((*last >= *first) ? (*last - *first + 1) : 0);
+}
+
+
+void sflash_config(void)
+{
+   flash_chip_type*   flash_chip = flash_chip_list;
+   int counter = 0;
+
+   printf("\nManual Flash Selection ... ");
+
+   while (flash_chip->vendid)
+   {
+      counter++;
+      if (counter == selected_fc)
+      {
+         vendid = flash_chip->vendid;
+         devid  = flash_chip->devid;
+         identify_flash_part();
+         break;
+      }
+      flash_chip++;
+   }
+
+    if (strcasecmp(flash_part,"")==0)
+       printf("*** Unknown or NO Flash Chip Selected ***\n");
+
+}
+
+unsigned int swap_bytes(unsigned int data, int num_bytes) {
+  unsigned int datab[4], i;
+
+  for (i = 0; i < num_bytes; i++) {
+    datab[i] = (data >>((num_bytes - i - 1) * 8) & 0xFF);
+  }
+
+  data = 0x0;
+  for (i = 0; i < num_bytes; i++) {
+    data = (data | (datab[i] <<(8 * i)));
+  }
+  return data;
+}
+
+void sflash_probe(void)
+{
+   flash_driver_type*  driver;
+   int retries = 300;
+   int cfi_found;
+
+    // Default to Standard Flash Window for Detection if not CUSTOM
+    if (strcasecmp(AREA_NAME,"CUSTOM")==0)
+         FLASH_MEMORY_START = selected_window;
+    else FLASH_MEMORY_START = 0x1FC00000;
+
+    printf("\nProbing Flash at (Flash Window: 0x%08x) ... ", FLASH_MEMORY_START);
+
+again:
+
+    strcpy(flash_part,"");
+
+    // Serial Flash Sits Behind The Chipcommon Controller, Not On The Bus
+    if (sflash_spi_detect())
+    {
+       printf("(Serial Flash, chipcommon rev %d) ... ", cc_revision);
+       sflash_select_driver(CMD_TYPE_SPI);
+       sflash_read_ids();
+       identify_flash_part();
+       if (flash_part[0] == 0)
+       {
+          printf("Done\n\n");
+          printf("Serial Flash Signature: %02x/%02x\n", vendid, devid);
+          printf("*** Unknown Serial Flash Chip Detected ***");
+       }
+       else sflash_spi_unprotect();
+       return;
+    }
+
+    // CFI Gives The Command Set & Geometry In One Pass (table entries still win)
+    cfi_found = sflash_cfi_query();
+    if (cfi_found)
+    {
+       sflash_read_ids();
+       identify_flash_part();
+       if (flash_part[0] == 0)  sflash_cfi_part();
+       return;
+    }
+
+    // Probe with each driver's ID sequence (command sets sharing one are tried once)
+    for (driver = flash_driver_list; driver->cmd_type && (flash_part[0] == 0); driver++)
+    {
+       if ((driver != flash_driver_list) && (driver->read_ids == (driver - 1)->read_ids))  continue;
+       if (driver->cmd_type == CMD_TYPE_SPI)  continue;
+       if (flash_x32 && (driver->cmd_type != CMD_TYPE_AMD))  continue;
+       sflash_select_driver(driver->cmd_type);
+       sflash_read_ids();
+       identify_flash_part();
+    }
+
+    if (flash_part[0] == 0)
+    {
+       // Only Worth Trying Again If Nothing Answered At All
+       if (((vendid == 0xFFFF) || (vendid == 0)) && retries--)
+          goto again;
+       else
+       {
+       	  printf("Done\n\n");
+          printf("*** Unknown or NO Flash Chip Detected ***");
+       }
+    }
+
+    return;
+}
+
+
+void sflash_poll_word(unsigned int addr, unsigned int data)
+{
+
+    // Link Slower Than The Chip - Checked Once Per Block Instead
+    if (skip_word_poll)
+    {
+       pending_poll      = 1;
+       pending_poll_addr = addr;
+       pending_poll_data = data;
+       return;
+    }
+
+    sflash_poll(addr, data);
+
+}
+
+
+void sflash_poll_pending(void)
+{
+
+    // Let The Last Unpolled Program Finish
+    if (pending_poll)
+    {
+       pending_poll = 0;
+       sflash_poll(pending_poll_addr, pending_poll_data);
+    }
+
+}
+
+
+void sflash_timing_model(void)
+{
+    double start_seconds;
+    int i;
+
+    if (!issue_timing)  return;
+
+    // Measure What One Flash Access Costs Over This Link
+    start_seconds = get_seconds();
+    for (i = 0; i < 64; i++)  ejtag_read_h(FLASH_MEMORY_START);
+    link_latency_us = ((get_seconds() - start_seconds) * 1000000) / 64;
+}
+
+
+unsigned int sflash_block_end(unsigned int addr, unsigned int end)
+{
+    int cur_block;
+    unsigned int block_end;
+
+    if (!block_total || (addr >= flash_map_end))  return end;
+
+    // Before The Map - Up To Its First Block
+    if (addr < flash_regions[0].start)  block_end = flash_regions[0].start;
+    else
+    {
+       cur_block = sflash_block_of(addr);
+       block_end = sflash_block_start(cur_block) + sflash_block_size(cur_block);
+    }
+
+    return (block_end < end) ? block_end : end;
+}
+
+
+int sflash_verify_range(unsigned int addr, unsigned int *data, unsigned int words, int *fixed)
+{
+    unsigned int *check;
+    unsigned int i;
+    int bad = 0;
+    int saved_skip = skip_word_poll;
+
+    *fixed = 0;
+    if (!words)  return 0;
+
+    check = malloc(words * 4);
+    if (check == NULL)
+    {
+       fprintf(stderr,"Could not allocate %d bytes for verify\n", words * 4);
+       exit(1);
+    }
+
+    // Intel Parts Are Left In Status Mode
+    sflash_poll_pending();
+    if (flash_driver->status_reads)  sflash_reset();
+
+    ejtag_read_block(addr, check, words);
+
+    // Program Again Only What Did Not Take, This Time Polled
+    skip_word_poll = 0;
+    for (i = 0; i < words; i++)
+    {
+       if (check[i] != data[i])
+       {
+          sflash_write_word(addr + (i * 4), data[i]);
+          (*fixed)++;
+       }
+    }
+    skip_word_poll = saved_skip;
+
+    // Anything Re-Programmed Gets Read Back Once More
+    if (*fixed)
+    {
+       if (flash_driver->status_reads)  sflash_reset();
+       ejtag_read_block(addr, check, words);
+       for (i = 0; i < words; i++)
+          if (check[i] != data[i])  bad++;
+    }
+
+    free(check);
+    return bad;
+}
+
+
+int sflash_check_block(unsigned int addr, unsigned int *data, unsigned int words, int *fixed)
+{
+    int bad;
+
+    // Anything Printed Here Has To Follow The Dump Of The Block
+    progress_flush();
+
+    bad = sflash_verify_range(addr, data, words, fixed);
+    if (*fixed)  printf("\n%d word(s) re-programmed in block at %08x\n", *fixed, addr);
+
+    // Still Wrong - Erase The Block & Try Again
+    if (bad)  bad = sflash_retry_block(addr, data, words);
+
+    if (bad)
+    {
+       verify_failed++;
+       printf("*** Block at %08x FAILED verify (%d word(s) wrong) ***\n", addr, bad);
+    }
+    else if (*fixed)  verify_repaired++;
+    else              verify_ok++;
+
+    return bad;
+}
+
+
+int sflash_retry_block(unsigned int addr, unsigned int *data, unsigned int words)
+{
+    unsigned int *target;
+    unsigned int block_start, block_size;
+    int cur_block, tries, fixed, bad = words;
+    int saved_skip = skip_word_poll;
+
+    cur_block = sflash_block_of(addr);
+    if (!cur_block)  return bad;
+
+    block_start = sflash_block_start(cur_block);
+    block_size  = sflash_block_size(cur_block);
+
+    target = malloc(block_size);
+    if (target == NULL)
+    {
+       fprintf(stderr,"Could not allocate %d bytes for block retry\n", block_size);
+       exit(1);
+    }
+
+    // Keep Whatever Else Lives In The Block
+    if (flash_driver->status_reads)  sflash_reset();
+    ejtag_read_block(block_start, target, block_size / 4);
+    memcpy(target + ((addr - block_start) / 4), data, words * 4);
+
+    skip_word_poll = 0;
+    for (tries = 1; tries <= VERIFY_RETRIES; tries++)
+    {
+       printf("Erasing & re-programming block at %08x (try %d)...", block_start, tries);  fflush(stdout);
+
+       // Unlock Bypass Takes No Erase Commands
+       sflash_unlock_bypass(0);
+       sflash_erase_block(block_start);
+       sflash_unlock_bypass(1);
+       sflash_program_words(block_start, target, block_size / 4);
+
+       bad = sflash_verify_range(block_start, target, block_size / 4, &fixed);
+       printf("%s\n", bad ? "Failed" : "Done");
+       if (!bad)  break;
+    }
+    skip_word_poll = saved_skip;
+
+    free(target);
+    return bad;
+}
+
+
+
+
+void sflash_wait(unsigned int addr, unsigned int ready)
+{
+
+    if (USE_DMA)
+    {
+       // Wait Until Ready
+       while ( (ejtag_read_h(addr) & STATUS_READY) != ready );
+    }
+    else
+    {
+       // Wait Until Ready (Poll Loop In RAM With /ramaddr, Else In One Debug Module)
+       addr = flash_bank_addr(addr);
+       while ( ejtag_poll_h(addr, STATUS_READY, ready) != ready );
+    }
+
+}
+
+
+void sflash_erase_area(unsigned int start, unsigned int length)
+{
+    int cur_block;
+    int tot_blocks;
+    int batch_count, batch_next;
+    int skip_blocks;
+    int first_block, last_block;
+    unsigned int batch[MAX_ERASE_BATCH];
+    double erase_seconds;
+    unsigned int reg_start;
+    unsigned int reg_end;
+
+
+    reg_start = start;
+    reg_end   = reg_start + length;
+
+    tot_blocks = 0;
+    skip_blocks = 0;
+
+    sflash_blocks_in(reg_start, reg_end, &first_block, &last_block);
+    for (cur_block = first_block;  cur_block <= last_block;  cur_block++)
+    {
+       if (erase_skip[cur_block])  skip_blocks++;
+       else tot_blocks++;
+    }
+
+    // Whole Device Requested - One Chip Erase Is Much Faster Than Block By Block
+    // (not when a resumed run has blocks it must keep)
+    if (issue_chiperase && (block_total > 0) && (reg_start <= flash_regions[0].start) && (reg_end >= flash_map_end) &&
+        (tot_blocks > skip_blocks) && !journal_done_blocks)
+    {
+       sflash_erase_chip();
+       journal_erased(first_block, last_block);
+       return;
+    }
+
+    if (skip_blocks)  printf("Blocks Already Blank: %d (not erased)\n", skip_blocks);
+
+    printf("Total Blocks to Erase: %d\n", tot_blocks);
+    if (issue_timing && flash_erase_typ)
+       printf("Expected Erase Time: about %d seconds\n", (tot_blocks * flash_erase_typ) / 1000);
+    printf("\n");
+
+    for (cur_block = first_block;  cur_block <= last_block;  cur_block++)
+    {
+       block_addr = sflash_block_start(cur_block);
+       if (!erase_skip[cur_block])
+          {
+             // AMD Parts Can Erase Several Sectors At Once (needs a RAM helper, no banking, x16)
+             if ((cmd_type == CMD_TYPE_AMD) && ram_helper_addr && !bank_register && !flash_x32)
+             {
+                batch_count = 0;
+                batch_next  = cur_block;
+                while ((batch_count < MAX_ERASE_BATCH) && (batch_next <= last_block) && !erase_skip[batch_next])
+                {
+                   batch[batch_count] = sflash_block_start(batch_next);
+                   batch_count++;
+                   batch_next++;
+                }
+
+                printf("Erasing blocks: %d-%d (addr = %08x)...", cur_block, cur_block + batch_count - 1, block_addr);  fflush(stdout);
+                batch_count = sflash_erase_batch(batch, batch_count);
+                if (batch_count)
+                {
+                   journal_erased(cur_block, cur_block + batch_count - 1);
+                   printf("Done\n");  fflush(stdout);
+                   cur_block += batch_count - 1;
+                   continue;
+                }
+                printf("Falling back to single blocks\n");
+             }
+
+             printf("Erasing block: %d (addr = %08x)...", cur_block, block_addr);  fflush(stdout);
+             erase_seconds = get_seconds();
+             sflash_erase_block(block_addr);
+             erase_seconds = get_seconds() - erase_seconds;
+             journal_erased(cur_block, cur_block);
+             if (issue_timing)  printf("Done  (%d ms)\n", (int)(erase_seconds * 1000));
+             else printf("Done\n");
+             if (flash_erase_max && ((erase_seconds * 1000) > flash_erase_max))
+                printf("*** Block took longer than the %d ms the chip allows ***\n", flash_erase_max);
+             fflush(stdout);
+          }
+    }
+
+}
+
+
+int sflash_dual_bank_ready(unsigned int start, unsigned int length)
+{
+    // Needs A Read-While-Write Part, An Erase That Can Be Left Running, And Work In Both Banks
+    if (!issue_dualbank || !issue_erase || !dual_bank_split || !flash_driver->erase_start || !flash_driver->erase_suspend || !flash_driver->erase_busy)  return 0;
+    return ((start < dual_bank_split) && ((start + length) > dual_bank_split));
+}
+
+
+static int sflash_erase_count(unsigned int start, unsigned int end)
+{
+    int cur_block, first_block, last_block;
+    int count = 0;
+
+    sflash_blocks_in(start, end, &first_block, &last_block);
+    for (cur_block = first_block;  cur_block && (cur_block <= last_block);  cur_block++)
+       if (!erase_skip[cur_block])  count++;
+
+    return count;
+}
+
+
+void sflash_dual_bank_area(unsigned int *image, unsigned int start, unsigned int length)
+{
+    unsigned int end = start + length;
+    unsigned int a_start, a_end, b_start, b_end;
+    int saved_bypass = issue_bypass;
+    int first_block, last_block;
+
+    // Bank With Less Erasing Goes First - Its Erase Is The Only One Not Hidden
+    if (sflash_erase_count(start, dual_bank_split) <= sflash_erase_count(dual_bank_split, end))
+    {
+       a_start = start;            a_end = dual_bank_split;
+       b_start = dual_bank_split;  b_end = end;
+    }
+    else
+    {
+       a_start = dual_bank_split;  a_end = end;
+       b_start = start;            b_end = dual_bank_split;
+    }
+
+    printf("Dual Bank: %08x-%08x erased first, %08x-%08x erased alongside it\n\n", a_start, a_end, b_start, b_end);
+
+    sflash_erase_area(a_start, a_end - a_start);
+
+    progress_start("Flashed", image_work(image, length / 4), 1);
+    bg_erase_failed  = 0;
+
+    // Unlock Bypass Only Takes Program Commands - Keep Full Sequences For Suspend & Resume
+    issue_bypass = 0;
+    sflash_blocks_in(b_start, b_end, &first_block, &last_block);
+    bg_erase_block = 0;
+    bg_erase_next  = first_block;
+    bg_erase_last  = last_block;
+    sflash_erase_step(0);
+
+    sflash_program_range(a_start, image + ((a_start - start) / 4), (a_end - a_start) / 4);
+    issue_bypass = saved_bypass;
+
+    // Programming Outran The Erase - Let It Finish
+    if (bg_erase_block)
+    {
+       printf("Waiting for the other bank to finish erasing...\n");  fflush(stdout);
+       sflash_erase_step(1);
+    }
+    sflash_reset();
+    memset(erase_skip, 0, block_total + 1);
+
+    if (bg_erase_failed)
+       printf("*** %d block(s) did not erase - expect them to fail verify ***\n", bg_erase_failed);
+
+    sflash_program_range(b_start, image + ((b_start - start) / 4), (b_end - b_start) / 4);
+    progress_end();
+    progress_by_work = 0;
+}
+
+
+int sflash_erase_step(int wait)
+{
+    unsigned int addr;
+    double erase_seconds;
+
+    // Erase Only Runs While Not Suspended
+    sflash_erase_hold(0);
+
+    while (1)
+    {
+       if (bg_erase_block)
+       {
+          addr = sflash_block_start(bg_erase_block);
+          if (flash_driver->erase_busy(addr))
+          {
+             if (!wait)  return 1;
+             sleep_ms(10);
+             continue;
+          }
+
+          erase_seconds = get_seconds() - bg_erase_seconds;
+          progress_flush();
+          if (ejtag_read(addr) != 0xFFFFFFFF)
+          {
+             // Protected Sectors Drop Straight Back To Read Mode
+             printf("*** Background erase of block %d (addr = %08x) failed ***\n", bg_erase_block, addr);
+             bg_erase_failed++;
+          }
+          else
+          {
+             journal_erased(bg_erase_block, bg_erase_block);
+             if (!silent_mode)
+             {
+                if (issue_timing)  printf("[Erased]   block %d (addr = %08x)  (%d ms)\n", bg_erase_block, addr, (int)(erase_seconds * 1000));
+                else printf("[Erased]   block %d (addr = %08x)\n", bg_erase_block, addr);
+             }
+          }
+          fflush(stdout);
+          bg_erase_block = 0;
+       }
+
+       // Next Block That Needs It
+       while (bg_erase_next && (bg_erase_next <= bg_erase_last) && erase_skip[bg_erase_next])  bg_erase_next++;
+       if (!bg_erase_next || (bg_erase_next > bg_erase_last))  return 0;
+
+       // Commands Are Ignored While A Program Is Still Running
+       sflash_poll_pending();
+
+       bg_erase_block   = bg_erase_next++;
+       bg_erase_seconds = get_seconds();
+       flash_driver->erase_start(sflash_block_start(bg_erase_block));
+       if (!wait)  return 1;
+    }
+}
+
+
+void sflash_erase_hold(int hold)
+{
+
+    // Read-While-Write Parts Still Only Program One Bank At A Time - Suspend The Other's Erase
+    if (!bg_erase_block || (hold == bg_erase_held))  return;
+
+    // Resume Is Ignored While A Program Is Still Running
+    if (!hold)  sflash_poll_pending();
+
+    flash_driver->erase_suspend(sflash_block_start(bg_erase_block), hold);
+    bg_erase_held = hold;
+
+}
+
+
+void sflash_wait_progress(unsigned int addr, unsigned int ready, double start_seconds)
+{
+
+    // Long Waits - Check Now And Then Rather Than Hammering The Bus
+    while ( (ejtag_read_h(addr) & STATUS_READY) != ready )
+    {
+       printf("Erasing ... elapsed = %d seconds\r", (int)(get_seconds() - start_seconds));
+       fflush(stdout);
+       sleep_ms(250);
+    }
+
+}
+
+
+void sflash_diff_area(unsigned int *image, unsigned int start, unsigned int length)
+{
+    unsigned int *target = NULL;
+    unsigned int *current = NULL;
+    unsigned int block_start, block_end, words, addr, i;
+    unsigned int end = start + length;
+    unsigned int old_data, new_data, total;
+    int cur_block, first_block, last_block;
+    int changed, needs_erase, fixed;
+    int blocks_same = 0, blocks_programmed = 0, blocks_erased = 0, blocks_basis = 0;
+    sparse_block_type *basis;
+
+    // Every Block Touching [start, end)
+    first_block = (start < flash_regions[0].start) ? 1 : sflash_block_of(start);
+    last_block  = (end >= flash_map_end) ? block_total : sflash_block_of(end - 1);
+    if (!first_block || (end <= flash_regions[0].start))  last_block = 0;
+
+    // Progress Covers Every Block We Look At
+    for (total = 0, cur_block = first_block;  cur_block <= last_block;  cur_block++)
+       total += sflash_block_size(cur_block);
+    progress_start("Flashed", total, 0);
+
+    printf("Comparing Flash Blocks against Image...\n\n");
+
+    for (cur_block = first_block;  cur_block <= last_block;  cur_block++)
     {
-        counter += 4;
-        percent_complete = (counter * 100 / length);
-        if (!silent_mode)
-           if ((addr&0xF) == 0)  printf("[%3d%% Flashed]   %08x: ", percent_complete, addr);
+       block_start = sflash_block_start(cur_block);
+       block_end   = block_start + sflash_block_size(cur_block);
 
-        fread( (unsigned char*) &data, 1,sizeof(data), fd);
+       words  = (block_end - block_start) / 4;
+       target  = realloc(target, words * sizeof(unsigned int));
+       current = realloc(current, words * sizeof(unsigned int));
+       if ((target == NULL) || (current == NULL))
+       {
+           fprintf(stderr,"Could not allocate %d bytes for block compare\n", words * 4);
+           exit(1);
+       }
 
-	if (bigendianfile) {
-	  data = swap_bytes(data, 4);
-	}
+       // Same Hash As The Basis Backup - Unchanged Without Reading Anything
+       basis = sparse_find(block_start, words * 4);
+       if (basis && (block_start >= start) && (block_end <= end) &&
+           (image_hash(image + ((block_start - start) / 4), words) == basis->hash))
+       {
+          progress_flush();
+          printf("Block: %d (addr = %08x)...Unchanged (basis)\n", cur_block, block_start);
+          blocks_same++;
+          blocks_basis++;
+          progress_advance(block_end - block_start);
+          continue;
+       }
 
-        // Erasing Flash Sets addresses to 0xFF's so we can avoid writing these (for speed)
-        if (issue_erase) {
-           if (!(data == 0xFFFFFFFF))
-              sflash_write_word(addr, data);
-        }
-        else sflash_write_word(addr, data);  // Otherwise we gotta flash it all
+       // Basis Has The Old Contents, Else Read Back What Is There Now (Intel parts may still be in status mode)
+       if (basis && sparse_read_block(basis, current))  blocks_basis++;
+       else
+       {
+          sflash_reset();
+          ejtag_read_block(block_start, current, words);
+       }
+
+       changed     = 0;
+       needs_erase = 0;
+       for (i = 0; i < words; i++)
+       {
+          addr = block_start + (i * 4);
+          old_data = current[i];
+          if ((addr < start) || (addr >= end))  new_data = old_data;   // Not ours, keep as is
+          else                                  new_data = image[(addr - start) / 4];
+
+          if (old_data != new_data)
+          {
+             changed = 1;
+             if ((old_data & new_data) != new_data)  needs_erase = 1;   // Needs a 0 -> 1
+          }
+          target[i] = new_data;
+       }
+
+       progress_flush();
+       printf("Block: %d (addr = %08x)...", cur_block, block_start);  fflush(stdout);
+
+       if (!changed)
+       {
+          blocks_same++;
+          progress_advance(block_end - block_start);
+          printf("Unchanged\n");
+       }
+       else if (!needs_erase)
+       {
+          // Only Clearing Bits - Program Just the Words that Differ
+          blocks_programmed++;
+          printf("Programming (no erase needed)\n");
+          sflash_unlock_bypass(1);
+          for (i = 0; i < words; i++)
+             if (target[i] != current[i])  sflash_write_word(block_start + (i * 4), target[i]);
+          show_progress("Flashed", block_start, target, words);
+          if (issue_verify)  sflash_check_block(block_start, target, words, &fixed);
+          sflash_unlock_bypass(0);
+          progress_flush();
+          if (!silent_mode)  printf("\n");
+       }
+       else
+       {
+          // Erase & Program Whole Block (bytes outside our area are put back)
+          blocks_erased++;
+          printf("Erasing & Programming\n");
+          sflash_erase_block(block_start);
+          sflash_program_range(block_start, target, words);
+          if (!silent_mode)  printf("\n");
+       }
+    }
+
+    progress_end();
+    free(target);
+    free(current);
+
+    printf("\nBlocks unchanged: %d  programmed: %d  erased & programmed: %d\n", blocks_same, blocks_programmed, blocks_erased);
+    if (blocks_basis)  printf("Blocks taken from the basis backup instead of the flash: %d\n", blocks_basis);
+    printf("\n");
+}
 
-        if (silent_mode)  printf("%4d%%   bytes = %d\r", percent_complete, counter);
-        else              printf("%08x%c", data, (addr&0xF)==0xC?'\n':' ');
-        
-        fflush(stdout);         	
-        data = 0xFFFFFFFF;  // This is in case file is shorter than expected length
-      }
-    fclose(fd);
-    printf("Done  (%s loaded into Flash Memory OK)\n\n",filename);
 
+int sflash_erase_batch(unsigned int *addrs, int count)
+{
+    unsigned int list[MAX_ERASE_BATCH];
+    unsigned int not_queued;
+    int i, queued;
+
+    for (i = 0; i < count; i++)  list[i] = (addrs[i] & 0x1FFFFFFF) | 0xA0000000;
+
+    if (!ejtag_call_helper(amd_multierase_ram_helper, sizeof(amd_multierase_ram_helper) / 4,
+                           list, count, (FLASH_MEMORY_START & 0x1FFFFFFF) | 0xA0000000, &not_queued))
+       return 0;
+
+    // The chip stops taking sectors once its timeout runs out, the rest go next time
+    queued = count - not_queued;
+
+    // Wait for Erase Completion (DQ7 stays low until every queued sector is done)
+    sflash_poll(addrs[queued - 1], 0xFFFF);
     sflash_reset();
 
-    printf("=========================\n");
-    printf("Flashing Routine Complete\n");
-    printf("=========================\n");
+    return queued;
+}
 
-    time(&end_time);
-    elapsed_seconds = difftime(end_time, start_time); 
-    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+
+// **************************************************************************
+// Flash Command Set Drivers
+//
+// Each driver supplies its command sequences; the program loops are stamped
+// out by FLASH_PROGRAM_LOOPS() once per access mode & endianness so the
+// word loop itself never looks at USE_DMA or bigendian.
+// **************************************************************************
+
+static void flash_write_h(unsigned int addr, unsigned int data, const int dma)
+{
+    if (dma) ejtag_dma_write_h(addr, data);
+    else     ejtag_pracc_write_h(addr, data);
+}
+
+
+// Values Landing At addr And addr+2 - DMA Uses Byte Lanes, PrAcc Does Not
+#define FLASH_PROGRAM_LOOP(name, program_half, dma, big)                                \
+static void name(unsigned int addr, unsigned int *data, unsigned int count)              \
+{                                                                                        \
+    unsigned int i, half_lo, half_hi;                                                    \
+                                                                                         \
+    for (i = 0; i < count; i++, addr += 4)                                               \
+    {                                                                                    \
+       half_lo = (big) ? ((data[i] >> 16) & 0xffff) : (data[i] & 0xffff);                \
+       half_hi = (big) ? (data[i] & 0xffff) : ((data[i] >> 16) & 0xffff);                \
+                                                                                         \
+       /* Programming 0xFFFF Leaves A Half Word As It Is - Skip It */                    \
+       if (half_lo != 0xFFFF)  program_half(addr,   (dma) ? data[i] : half_lo, half_lo, dma); \
+       if (half_hi != 0xFFFF)  program_half(addr+2, (dma) ? data[i] : half_hi, half_hi, dma); \
+    }                                                                                    \
+}
+
+#define FLASH_PROGRAM_LOOPS(family)                                                      \
+   FLASH_PROGRAM_LOOP(family##_program_pracc_le, family##_program_half, 0, 0)            \
+   FLASH_PROGRAM_LOOP(family##_program_pracc_be, family##_program_half, 0, 1)            \
+   FLASH_PROGRAM_LOOP(family##_program_dma_le,   family##_program_half, 1, 0)            \
+   FLASH_PROGRAM_LOOP(family##_program_dma_be,   family##_program_half, 1, 1)
+
+#define FLASH_PROGRAM_TABLE(family)                                                      \
+   { { family##_program_pracc_le, family##_program_pracc_be },                           \
+     { family##_program_dma_le,   family##_program_dma_be   } }
+
+
+// Write Buffer Fill - Same Idea As The Program Loops
+#define FLASH_BUFFER_FILL(name, dma, big)                                                \
+static void name(unsigned int addr, unsigned int *data, unsigned int count)              \
+{                                                                                        \
+    unsigned int i;                                                                      \
+                                                                                         \
+    for (i = 0; i < count; i++, addr += 4)                                               \
+    {                                                                                    \
+       flash_write_h(addr,   (dma) ? data[i] : ((big) ? (data[i] >> 16) : (data[i] & 0xffff)), dma); \
+       flash_write_h(addr+2, (dma) ? data[i] : ((big) ? (data[i] & 0xffff) : (data[i] >> 16)), dma); \
+    }                                                                                    \
+}
+
+FLASH_BUFFER_FILL(flash_fill_pracc_le, 0, 0)
+FLASH_BUFFER_FILL(flash_fill_pracc_be, 0, 1)
+FLASH_BUFFER_FILL(flash_fill_dma_le,   1, 0)
+FLASH_BUFFER_FILL(flash_fill_dma_be,   1, 1)
+
+static program_loop_type flash_buffer_fill[2][2] = {
+   { flash_fill_pracc_le, flash_fill_pracc_be },
+   { flash_fill_dma_le,   flash_fill_dma_be   } };
+
+
+static unsigned int flash_buffer_last(unsigned int *data, unsigned int count)
+{
+    // Half Word That Lands Last In The Buffer
+    if (!bigendian)  return ((data[count - 1] >> 16) & 0xffff);
+    return (data[count - 1] & 0xffff);
+}
+
+
+// ---- AMD ----
+
+static void amd_read_ids(void)
+{
+    sflash_reset();
+    ejtag_write_h(FLASH_MEMORY_START + (0x555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START + (0x2AA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START + (0x555 << 1), 0x00900090);
+    vendid = ejtag_read_h(FLASH_MEMORY_START);
+    devid  = ejtag_read_h(FLASH_MEMORY_START+2);
+}
+
+
+static void amd_reset(void)
+{
+    ejtag_write_h(FLASH_MEMORY_START, 0x00F000F0);    // Set array to read mode
+}
+
+
+static void amd_poll(unsigned int addr, unsigned int data)
+{
+    // DQ7 Reads Back Its True Data When Done
+    sflash_wait(addr, data & STATUS_READY);
+}
+
+
+static void amd_erase_start(unsigned int addr)
+{
+    //Unlock Block
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00800080);
+
+    //Erase Block
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
+    ejtag_write_h(addr, 0x00300030);
+}
+
+
+static void amd_erase_suspend(unsigned int addr, int suspend)
+{
+    if (suspend)
+    {
+       // DQ6 Stops Toggling Once Suspended (or if the erase already finished)
+       ejtag_write_h(addr, 0x00B000B0);
+       while ((ejtag_read_h(addr) ^ ejtag_read_h(addr)) & 0x40);
+    }
+    else
+    {
+       ejtag_write_h(addr, 0x00300030);
+    }
+}
+
+
+static int amd_erase_busy(unsigned int addr)
+{
+    // DQ6 Toggles On Every Read While The Bank Is Busy
+    return ((ejtag_read_h(addr) ^ ejtag_read_h(addr)) & 0x40) ? 1 : 0;
+}
+
+
+static void amd_erase_block(unsigned int addr)
+{
+    amd_erase_start(addr);
+
+    // Wait for Erase Completion
+    sflash_poll(addr, 0xFFFF);
+}
+
+
+static void amd_erase_chip(double start_seconds)
+{
+    //Unlock Chip
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00800080);
+
+    //Erase Chip
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00100010);
+
+    // Wait for Erase Completion
+    sflash_wait_progress(FLASH_MEMORY_START, STATUS_READY, start_seconds);
+}
+
+
+static void amd_unlock_bypass(int enable)
+{
+    if (enable)
+    {
+       // Enter Unlock Bypass - Program is then just A0 + Data
+       ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
+       ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
+       ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00200020);
+    }
+    else
+    {
+       // Exit Unlock Bypass (the normal reset command is ignored in this mode)
+       ejtag_write_h(FLASH_MEMORY_START, 0x00900090);
+       ejtag_write_h(FLASH_MEMORY_START, 0x00000000);
+    }
+}
+
+
+static int amd_buffer_poll(unsigned int addr, unsigned int data)
+{
+    unsigned int status;
+
+    // DQ7 Reads Back Its True Data When Done - DQ1 (abort) Or DQ5 (timeout) Means It Never Will
+    while (1)
+    {
+       status = ejtag_read_h(addr);
+       if (!((status ^ data) & STATUS_READY))  return 1;
+       if (status & 0x0022)  break;
+    }
+
+    // DQ7 Is Checked Once More - The Part May Have Finished As DQ1/DQ5 Were Read
+    return !((ejtag_read_h(addr) ^ data) & STATUS_READY);
+}
+
+
+static void amd_write_buffer(unsigned int addr, unsigned int *data, unsigned int count)
+{
+    unsigned int halves = count * 2;
+
+    // Write to Buffer - Sector Address Then Half Word Count - 1
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
+    ejtag_write_h(addr, 0x00250025);
+    ejtag_write_h(addr, ((halves - 1) << 16) | (halves - 1));
+
+    flash_buffer_fill[USE_DMA ? 1 : 0][bigendian ? 1 : 0](flash_bank_addr(addr), data, count);
+
+    // Program Buffer to Flash & Wait on the Last Half Word
+    ejtag_write_h(addr, 0x00290029);
+    if (amd_buffer_poll(addr + (count * 4) - 2, flash_buffer_last(data, count)))  return;
+
+    // Write-to-Buffer-Abort Ignores Everything Until Its Own Reset - Then Do It A Word At A Time
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00F000F0);
+    progress_flush();
+    printf("*** Write buffer at %08x aborted - programming it a word at a time ***\n", addr);
+    flash_driver->program[USE_DMA ? 1 : 0][bigendian ? 1 : 0](addr, data, count);
+}
+
+
+static void amd_program_half(unsigned int addr, unsigned int data, unsigned int value, const int dma)
+{
+    flash_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA, dma);
+    flash_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055, dma);
+    flash_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00A000A0, dma);
+    flash_write_h(flash_bank_addr(addr), data, dma);
+
+    // Wait for Completion
+    sflash_poll_word(addr, value);
+}
+
+
+static void amd_bypass_program_half(unsigned int addr, unsigned int data, unsigned int value, const int dma)
+{
+    // Already Unlocked
+    flash_write_h(FLASH_MEMORY_START, 0x00A000A0, dma);
+    flash_write_h(flash_bank_addr(addr), data, dma);
+
+    // Wait for Completion
+    sflash_poll_word(addr, value);
+}
+
+FLASH_PROGRAM_LOOPS(amd)
+FLASH_PROGRAM_LOOPS(amd_bypass)
+
+
+// ---- AMD x32 (two x16 chips side by side - each command reaches both) ----
+
+static void flash_write(unsigned int addr, unsigned int data, const int dma)
+{
+    if (dma) ejtag_dma_write(addr, data);
+    else     ejtag_pracc_write(addr, data);
+}
+
+
+// Whole Words - The CPU Puts Each Half On The Lane Of Its Own Chip
+#define FLASH_PROGRAM_LOOP_X32(name, program_word, dma)                                  \
+static void name(unsigned int addr, unsigned int *data, unsigned int count)              \
+{                                                                                        \
+    unsigned int i;                                                                      \
+                                                                                         \
+    for (i = 0; i < count; i++, addr += 4)                                               \
+       if (data[i] != 0xFFFFFFFF)  program_word(addr, data[i], dma);                     \
+}
+
+#define FLASH_PROGRAM_LOOPS_X32(family)                                                  \
+   FLASH_PROGRAM_LOOP_X32(family##_program_pracc, family##_program_word, 0)              \
+   FLASH_PROGRAM_LOOP_X32(family##_program_dma,   family##_program_word, 1)
+
+#define FLASH_PROGRAM_TABLE_X32(family)                                                  \
+   { { family##_program_pracc, family##_program_pracc },                                 \
+     { family##_program_dma,   family##_program_dma   } }
+
+
+static void amd_x32_read_ids(void)
+{
+    unsigned int id;
+
+    sflash_reset();
+    sflash_cmd(0x555, 0x00AA00AA);
+    sflash_cmd(0x2AA, 0x00550055);
+    sflash_cmd(0x555, 0x00900090);
+    id     = ejtag_read(FLASH_MEMORY_START);
+    vendid = id & 0xFFFF;
+    devid  = ejtag_read(FLASH_MEMORY_START + 4) & 0xFFFF;
+
+    // Both Chips Have To Be The Same Part
+    if ((id >> 16) != vendid)  vendid = 0;
+}
+
+
+static void amd_x32_reset(void)
+{
+    ejtag_write(FLASH_MEMORY_START, 0x00F000F0);    // Set both arrays to read mode
+}
+
+
+static void amd_x32_poll(unsigned int addr, unsigned int data)
+{
+    // DQ7 Of Each Chip Reads Back Its True Data When Done
+    while ((ejtag_read(addr) & X32_STATUS_READY) != (data & X32_STATUS_READY));
+}
+
+
+static void amd_x32_erase_start(unsigned int addr)
+{
+    //Unlock Block
+    sflash_cmd(0x555, 0x00AA00AA);
+    sflash_cmd(0x2AA, 0x00550055);
+    sflash_cmd(0x555, 0x00800080);
+
+    //Erase Block
+    sflash_cmd(0x555, 0x00AA00AA);
+    sflash_cmd(0x2AA, 0x00550055);
+    ejtag_write(addr, 0x00300030);
+}
+
+
+static void amd_x32_erase_suspend(unsigned int addr, int suspend)
+{
+    if (suspend)
+    {
+       ejtag_write(addr, 0x00B000B0);
+       while ((ejtag_read(addr) ^ ejtag_read(addr)) & X32_STATUS_TOGGLE);
+    }
+    else
+    {
+       ejtag_write(addr, 0x00300030);
+    }
+}
+
+
+static int amd_x32_erase_busy(unsigned int addr)
+{
+    // Either Chip Of The Pair Still Toggling
+    return ((ejtag_read(addr) ^ ejtag_read(addr)) & X32_STATUS_TOGGLE) ? 1 : 0;
+}
+
+
+static void amd_x32_erase_block(unsigned int addr)
+{
+    amd_x32_erase_start(addr);
+
+    // Wait for Erase Completion
+    sflash_poll(addr, 0xFFFFFFFF);
+}
+
+
+static void amd_x32_erase_chip(double start_seconds)
+{
+    //Unlock Chip
+    sflash_cmd(0x555, 0x00AA00AA);
+    sflash_cmd(0x2AA, 0x00550055);
+    sflash_cmd(0x555, 0x00800080);
+
+    //Erase Chip
+    sflash_cmd(0x555, 0x00AA00AA);
+    sflash_cmd(0x2AA, 0x00550055);
+    sflash_cmd(0x555, 0x00100010);
+
+    // Wait for Both Chips
+    while ((ejtag_read(FLASH_MEMORY_START) & X32_STATUS_READY) != X32_STATUS_READY)
+    {
+       printf("Erasing ... elapsed = %d seconds\r", (int)(get_seconds() - start_seconds));
+       fflush(stdout);
+       sleep_ms(250);
+    }
+}
+
+
+static void amd_x32_unlock_bypass(int enable)
+{
+    if (enable)
+    {
+       sflash_cmd(0x555, 0x00AA00AA);
+       sflash_cmd(0x2AA, 0x00550055);
+       sflash_cmd(0x555, 0x00200020);
+    }
+    else
+    {
+       ejtag_write(FLASH_MEMORY_START, 0x00900090);
+       ejtag_write(FLASH_MEMORY_START, 0x00000000);
+    }
+}
+
+
+static void amd_x32_program_word(unsigned int addr, unsigned int data, const int dma)
+{
+    flash_write(FLASH_MEMORY_START+(0x555 << 2), 0x00AA00AA, dma);
+    flash_write(FLASH_MEMORY_START+(0x2AA << 2), 0x00550055, dma);
+    flash_write(FLASH_MEMORY_START+(0x555 << 2), 0x00A000A0, dma);
+    flash_write(flash_bank_addr(addr), data, dma);
+
+    // Wait for Completion
+    sflash_poll_word(addr, data);
+}
+
+
+static void amd_x32_bypass_program_word(unsigned int addr, unsigned int data, const int dma)
+{
+    flash_write(FLASH_MEMORY_START, 0x00A000A0, dma);
+    flash_write(flash_bank_addr(addr), data, dma);
+
+    // Wait for Completion
+    sflash_poll_word(addr, data);
+}
+
+FLASH_PROGRAM_LOOPS_X32(amd_x32)
+FLASH_PROGRAM_LOOPS_X32(amd_x32_bypass)
+
+
+// ---- SST ----
+
+static void sst_read_ids(void)
+{
+    sflash_reset();
+    ejtag_write_h(FLASH_MEMORY_START + (0x5555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START + (0x2AAA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START + (0x5555 << 1), 0x00900090);
+    vendid = ejtag_read_h(FLASH_MEMORY_START);
+    devid  = ejtag_read_h(FLASH_MEMORY_START+2);
+}
+
+
+static void sst_erase_block(unsigned int addr)
+{
+    //Unlock Block
+    ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00800080);
+
+    //Erase Block
+    ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
+    ejtag_write_h(addr, 0x00500050);
+
+    // Wait for Erase Completion
+    sflash_poll(addr, 0xFFFF);
+}
+
+
+static void sst_erase_chip(double start_seconds)
+{
+    //Unlock Chip
+    ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00800080);
+
+    //Erase Chip
+    ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
+    ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
+    ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00100010);
+
+    // Wait for Erase Completion
+    sflash_wait_progress(FLASH_MEMORY_START, STATUS_READY, start_seconds);
+}
+
+
+static void sst_program_half(unsigned int addr, unsigned int data, unsigned int value, const int dma)
+{
+    flash_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA, dma);
+    flash_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055, dma);
+    flash_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00A000A0, dma);
+    flash_write_h(flash_bank_addr(addr), data, dma);
+
+    // Wait for Completion
+    sflash_poll_word(addr, value);
+}
+
+FLASH_PROGRAM_LOOPS(sst)
+
+
+// ---- Intel BSC & SCS ----
+
+static void intel_read_ids(void)
+{
+    sflash_reset();
+    ejtag_write_h(FLASH_MEMORY_START, 0x00900090);
+    vendid = ejtag_read_h(FLASH_MEMORY_START);
+    devid  = ejtag_read_h(FLASH_MEMORY_START+2);
+}
+
+
+static void intel_reset(void)
+{
+    ejtag_write_h(FLASH_MEMORY_START, 0x00500050);    // Clear CSR
+    ejtag_write_h(FLASH_MEMORY_START, 0x00ff00ff);    // Set array to read mode
+}
+
+
+static void intel_poll(unsigned int addr, unsigned int data)
+{
+    // Status Register Reads Back At Any Address
+    sflash_wait(FLASH_MEMORY_START, STATUS_READY);
+}
+
+
+static void intel_erase_block(unsigned int addr)
+{
+    //Unlock Block
+    ejtag_write_h(addr, 0x00500050);     // Clear Status Command
+    ejtag_write_h(addr, 0x00600060);     // Unlock Flash Block Command
+    ejtag_write_h(addr, 0x00D000D0);     // Confirm Command
+
+    // Wait for Unlock Completion
+    sflash_poll(addr, STATUS_READY);
+
+    //Erase Block
+    ejtag_write_h(addr, 0x00500050);     // Clear Status Command
+    ejtag_write_h(addr, 0x00200020);     // Block Erase Command
+    ejtag_write_h(addr, 0x00D000D0);     // Confirm Command
+
+    // Wait for Erase Completion
+    sflash_poll(addr, STATUS_READY);
+}
+
+
+static void intel_erase_blocks(double start_seconds)
+{
+    int cur_block;
+    double last_report = start_seconds;
+
+    // No Chip Erase Command - Erase Block By Block, Reporting Progress Now And Then
+    for (cur_block = 1;  cur_block <= block_total;  cur_block++)
+    {
+       block_addr = sflash_block_start(cur_block);
+       ejtag_write_h(block_addr, 0x00500050);     // Clear Status Command
+       ejtag_write_h(block_addr, 0x00200020);     // Block Erase Command
+       ejtag_write_h(block_addr, 0x00D000D0);     // Confirm Command
+       sflash_poll(block_addr, STATUS_READY);
+
+       if ((get_seconds() - last_report) >= 1.0)
+       {
+          last_report = get_seconds();
+          printf("%4d%%   blocks = %d   elapsed = %d seconds\r", (cur_block * 100) / block_total, cur_block, (int)(last_report - start_seconds));
+          fflush(stdout);
+       }
+    }
 }
 
 
-void run_erase(char *filename, unsigned int start, unsigned int length)
+static void bsc_erase_chip(double start_seconds)
 {
-    time_t start_time = time(0);
-    time_t end_time, elapsed_seconds;
+    int cur_block;
 
-    printf("*** You Selected to Erase the %s ***\n\n",filename);
+    // Unlock Everything Up Front
+    for (cur_block = 1;  cur_block <= block_total;  cur_block++)
+    {
+       block_addr = sflash_block_start(cur_block);
+       ejtag_write_h(block_addr, 0x00600060);   // Unlock Flash Block Command
+       ejtag_write_h(block_addr, 0x00D000D0);   // Confirm Command
+    }
 
-    printf("=========================\n");
-    printf("Erasing Routine Started\n");
-    printf("=========================\n");
+    intel_erase_blocks(start_seconds);
+}
 
-    sflash_erase_area(start,length);
-    sflash_reset();
 
-    printf("=========================\n");
-    printf("Erasing Routine Complete\n");
-    printf("=========================\n");
+static void scs_erase_chip(double start_seconds)
+{
+    // One Command Clears Every Lock-Bit
+    ejtag_write_h(FLASH_MEMORY_START, 0x00500050);     // Clear Status Command
+    ejtag_write_h(FLASH_MEMORY_START, 0x00600060);     // Clear Block Lock-Bits Command
+    ejtag_write_h(FLASH_MEMORY_START, 0x00D000D0);     // Confirm Command (clears all blocks)
+    sflash_wait_progress(FLASH_MEMORY_START, STATUS_READY, start_seconds);
 
-    time(&end_time);
-    elapsed_seconds = difftime(end_time, start_time); 
-    printf("elapsed time: %d seconds\n", (int)elapsed_seconds);
+    intel_erase_blocks(start_seconds);
 }
 
 
-void identify_flash_part(void)
+static void scs_write_buffer(unsigned int addr, unsigned int *data, unsigned int count)
 {
-   flash_chip_type*   flash_chip = flash_chip_list;
-   flash_area_type*   flash_area = flash_area_list;
+    unsigned int halves = count * 2;
+    int tries;
 
-   // Important for these to initialize to zero
-   block_addr  = 0;
-   block_total = 0;
-   flash_size  = 0;
-   cmd_type    = 0;
-   strcpy(flash_part,"");
+    // Write to Buffer - Issued Again Until The XSR Says A Buffer Is Free
+    ejtag_write_h(addr, 0x00500050);     // Clear Status Command
+    for (tries = 0; tries < WRITE_BUFFER_TRIES; tries++)
+    {
+       ejtag_write_h(addr, 0x00E800E8);  // Write to Buffer Command
+       if (ejtag_read_h(addr) & STATUS_READY)  break;
+    }
+    if (tries == WRITE_BUFFER_TRIES)
+    {
+       // Left For The Verify Pass To Catch & Retry
+       ejtag_write_h(addr, 0x00FF00FF);  // Read Array Command
+       progress_flush();
+       printf("*** Write buffer at %08x never came free ***\n", addr);
+       return;
+    }
+    ejtag_write_h(addr, ((halves - 1) << 16) | (halves - 1));
 
-   // Funky AMD Chip
-   if (((vendid & 0x00ff) == 0x0001) && (devid == 0x227E))  devid = ejtag_read_h(FLASH_MEMORY_START+0x1E);  // Get real devid
+    flash_buffer_fill[USE_DMA ? 1 : 0][bigendian ? 1 : 0](flash_bank_addr(addr), data, count);
 
-   //   printf("vendid: %x, devid: %x\n", vendid, devid);
+    // Confirm & Wait for Completion
+    ejtag_write_h(addr, 0x00D000D0);
+    sflash_poll(addr, STATUS_READY);
+}
 
-   while (flash_chip->vendid)
-   {
-      if ((flash_chip->vendid == vendid) && (flash_chip->devid == devid))
-      {
-         flash_size = flash_chip->flash_size;
-         cmd_type   = flash_chip->cmd_type;
-         strcpy(flash_part, flash_chip->flash_part);
 
-         if (flash_size >= size8MB) FLASH_MEMORY_START = 0x1C000000;
-         else FLASH_MEMORY_START = 0x1FC00000;
+static void intel_program_half(unsigned int addr, unsigned int data, unsigned int value, const int dma)
+{
+    unsigned int phys = flash_bank_addr(addr);
 
-         while (flash_area->chip_size)
-         {
-            if ((flash_area->chip_size == flash_size) && (strcasecmp(flash_area->area_name, AREA_NAME)==0))
-            {
-               strcat(AREA_NAME,".BIN");
-               AREA_START  = flash_area->area_start;
-               AREA_LENGTH = flash_area->area_length;
-               break;
-            }
-            flash_area++;
-         }
-         
-         if (strcasecmp(AREA_NAME,"CUSTOM")==0)
-         {
-            strcat(AREA_NAME,".BIN");
-            FLASH_MEMORY_START = selected_window;
-            AREA_START         = selected_start;
-            AREA_LENGTH        = selected_length;
-         }
+    flash_write_h(phys, 0x00500050, dma);     // Clear Status Command
+    flash_write_h(phys, 0x00400040, dma);     // Write Command
+    flash_write_h(phys, data, dma);           // Send HalfWord Data
+    flash_write_h(phys, 0x00700070, dma);     // Check Status Command
 
-         if (flash_chip->region1_num)  define_block(flash_chip->region1_num, flash_chip->region1_size);
-         if (flash_chip->region2_num)  define_block(flash_chip->region2_num, flash_chip->region2_size);
-         if (flash_chip->region3_num)  define_block(flash_chip->region3_num, flash_chip->region3_size);
-         if (flash_chip->region4_num)  define_block(flash_chip->region4_num, flash_chip->region4_size);
+    // Wait for Completion
+    sflash_poll_word(addr, STATUS_READY);
+}
 
-         sflash_reset();
+FLASH_PROGRAM_LOOPS(intel)
 
-         printf("Done\n\n");
-         printf("Flash Vendor ID: ");  ShowData(vendid);
-         printf("Flash Device ID: ");  ShowData(devid);
-         if (selected_fc != 0)
-            printf("*** Manually Selected a %s Flash Chip ***\n\n", flash_part);
-         else
-            printf("*** Found a %s Flash Chip ***\n\n", flash_part);
 
-         printf("    - Flash Chip Window Start .... : %08x\n", FLASH_MEMORY_START);
-         printf("    - Flash Chip Window Length ... : %08x\n", flash_size);
-         printf("    - Selected Area Start ........ : %08x\n", AREA_START);
-         printf("    - Selected Area Length ....... : %08x\n\n", AREA_LENGTH);
-         
-         break;
-      }
-      flash_chip++;
-   }
+// ---- Broadcom Chipcommon Serial Flash (ST compatible SPI) ----
+
+static void spi_cmd(unsigned int opcode)
+{
+    // Start The Command & Wait For The Controller To Finish It
+    ejtag_write(CC_FLASHCONTROL, SFLASH_START | opcode);
+    while (ejtag_read(CC_FLASHCONTROL) & SFLASH_BUSY);
 }
 
 
-void define_block(unsigned int block_count, unsigned int block_size)
+static void spi_wait(void)
 {
-  unsigned int  i;
+    // Write In Progress Clears When The Part Is Done
+    do
+    {
+       spi_cmd(SFLASH_ST_RDSR);
+    } while (ejtag_read(CC_FLASHDATA) & SFLASH_ST_WIP);
+}
 
-  if (block_addr == 0)  block_addr = FLASH_MEMORY_START;
 
-  for (i = 1; i <= block_count; i++)
-  {
-     block_total++;
-     blocks[block_total] = block_addr;
-     block_addr = block_addr + block_size;
-  }
+static void spi_read_ids(void)
+{
+    // RES Also Releases From Deep Power-Down (SST needs address 1 for the device id)
+    ejtag_write(CC_FLASHADDRESS, 0);
+    spi_cmd(SFLASH_ST_RES);
+    devid  = ejtag_read(CC_FLASHDATA) & 0xFF;
+    vendid = 0x0020;
+
+    if (devid == 0xBF)
+    {
+       ejtag_write(CC_FLASHADDRESS, 1);
+       spi_cmd(SFLASH_ST_RES);
+       vendid = 0x00BF;
+       devid  = ejtag_read(CC_FLASHDATA) & 0xFF;
+    }
 }
 
 
-void sflash_config(void)
+static void spi_reset(void)
 {
-   flash_chip_type*   flash_chip = flash_chip_list;
-   int counter = 0;
+    // Reads Always Go Through The Memory Window - Nothing To Do
+}
 
-   printf("\nManual Flash Selection ... ");
 
-   while (flash_chip->vendid)
-   {
-      counter++;
-      if (counter == selected_fc)
-      {
-         vendid = flash_chip->vendid;
-         devid  = flash_chip->devid;
-         identify_flash_part();
-         break;
-      }
-      flash_chip++;
-   }
+static void spi_poll(unsigned int addr, unsigned int data)
+{
+    spi_wait();
+}
 
-    if (strcasecmp(flash_part,"")==0)
-       printf("*** Unknown or NO Flash Chip Selected ***\n");
 
+static void spi_erase_block(unsigned int addr)
+{
+    spi_cmd(SFLASH_ST_WREN);
+    ejtag_write(CC_FLASHADDRESS, addr - FLASH_MEMORY_START);
+    spi_cmd(SFLASH_ST_SE);
+    spi_wait();
 }
 
-unsigned int swap_bytes(unsigned int data, int num_bytes) {
-  unsigned int datab[4], i;
 
-  for (i = 0; i < num_bytes; i++) {
-    datab[i] = (data >>((num_bytes - i - 1) * 8) & 0xFF);
-  }
+static void spi_erase_chip(double start_seconds)
+{
+    spi_cmd(SFLASH_ST_WREN);
+    spi_cmd(SFLASH_ST_BE);
 
-  data = 0x0;
-  for (i = 0; i < num_bytes; i++) {
-    data = (data | (datab[i] <<(8 * i)));
-  }
-  return data;
+    // Long Wait - Check Now And Then Rather Than Hammering The Bus
+    do
+    {
+       printf("Erasing ... elapsed = %d seconds\r", (int)(get_seconds() - start_seconds));
+       fflush(stdout);
+       sleep_ms(250);
+       spi_cmd(SFLASH_ST_RDSR);
+    } while (ejtag_read(CC_FLASHDATA) & SFLASH_ST_WIP);
 }
 
-void sflash_probe(void)
-{
-   int retries = 300;
 
-    // Default to Standard Flash Window for Detection if not CUSTOM
-    if (strcasecmp(AREA_NAME,"CUSTOM")==0)
-         FLASH_MEMORY_START = selected_window;
-    else FLASH_MEMORY_START = 0x1FC00000;
+static void spi_program_byte(unsigned int offset, unsigned int data)
+{
+    spi_cmd(SFLASH_ST_WREN);
+    ejtag_write(CC_FLASHADDRESS, offset);
+    ejtag_write(CC_FLASHDATA, data);
+    spi_cmd(SFLASH_ST_PP);
+    spi_wait();
+}
 
-    printf("\nProbing Flash at (Flash Window: 0x%08x) ... ", FLASH_MEMORY_START);
 
-again:
+// Bytes In Flash Order - Skipping 0xFF's (programming them changes nothing)
+#define SPI_PROGRAM_LOOP(name, big)                                                      \
+static void name(unsigned int addr, unsigned int *data, unsigned int count)              \
+{                                                                                        \
+    unsigned int i, k, byte;                                                             \
+    unsigned int offset = addr - FLASH_MEMORY_START;                                     \
+                                                                                         \
+    for (i = 0; i < count; i++, offset += 4)                                             \
+    {                                                                                    \
+       for (k = 0; k < 4; k++)                                                           \
+       {                                                                                 \
+          byte = (data[i] >> ((big) ? (24 - (k * 8)) : (k * 8))) & 0xFF;                 \
+          if (byte != 0xFF)  spi_program_byte(offset + k, byte);                         \
+       }                                                                                 \
+    }                                                                                    \
+}
 
-    strcpy(flash_part,"");
+SPI_PROGRAM_LOOP(spi_program_le, 0)
+SPI_PROGRAM_LOOP(spi_program_be, 1)
 
-    // Probe using cmd_type for AMD
-    if (strcasecmp(flash_part,"")==0)
-    {
-       cmd_type = CMD_TYPE_AMD;
-       sflash_reset();
-       ejtag_write_h(FLASH_MEMORY_START + (0x555 << 1), 0x00AA00AA);
-       ejtag_write_h(FLASH_MEMORY_START + (0x2AA << 1), 0x00550055);
-       ejtag_write_h(FLASH_MEMORY_START + (0x555 << 1), 0x00900090);
-       vendid = ejtag_read_h(FLASH_MEMORY_START);
-       devid  = ejtag_read_h(FLASH_MEMORY_START+2);
-       identify_flash_part();
-    }
 
-    // Probe using cmd_type for SST
-    if (strcasecmp(flash_part,"")==0)
-    {
-       cmd_type = CMD_TYPE_SST;
-       sflash_reset();
-       ejtag_write_h(FLASH_MEMORY_START + (0x5555 << 1), 0x00AA00AA);
-       ejtag_write_h(FLASH_MEMORY_START + (0x2AAA << 1), 0x00550055);
-       ejtag_write_h(FLASH_MEMORY_START + (0x5555 << 1), 0x00900090);
-       vendid = ejtag_read_h(FLASH_MEMORY_START);
-       devid  = ejtag_read_h(FLASH_MEMORY_START+2);
-       identify_flash_part();
-    }
+static void spi_write_buffer(unsigned int addr, unsigned int *data, unsigned int count)
+{
+    unsigned int i, k, byte;
+    int big = bigendian;
 
-    // Probe using cmd_type for BSC & SCS
-    if (strcasecmp(flash_part,"")==0)
+    // Only Newer Controllers Can Hold Chip Select Across A Whole Page (SST25 has no Page Program at all)
+    if ((cc_revision < 20) || (vendid == 0x00BF))
     {
-       cmd_type = CMD_TYPE_BSC;
-       sflash_reset();
-       ejtag_write_h(FLASH_MEMORY_START, 0x00900090);
-       vendid = ejtag_read_h(FLASH_MEMORY_START);
-       devid  = ejtag_read_h(FLASH_MEMORY_START+2);
-       identify_flash_part();
+       if (big) spi_program_be(addr, data, count);
+       else     spi_program_le(addr, data, count);
+       return;
     }
 
-    if (strcasecmp(flash_part,"")==0)
+    spi_cmd(SFLASH_ST_WREN);
+    ejtag_write(CC_FLASHADDRESS, addr - FLASH_MEMORY_START);
+    for (i = 0; i < count; i++)
     {
-       if (retries--)
-          goto again;
-       else
+       for (k = 0; k < 4; k++)
        {
-       	  printf("Done\n\n");
-          printf("*** Unknown or NO Flash Chip Detected ***");
+          byte = (data[i] >> (big ? (24 - (k * 8)) : (k * 8))) & 0xFF;
+          if ((i == 0) && (k == 0))
+          {
+             // Page Program Command Carries The Address & First Byte
+             ejtag_write(CC_FLASHDATA, byte);
+             spi_cmd(SFLASH_ST_CSA | SFLASH_ST_PP);
+          }
+          else
+          {
+             // Each Further Byte - A Byte Started While The Controller Is Busy Is Lost
+             spi_cmd(SFLASH_ST_CSA | byte);
+          }
        }
     }
 
-    return;
+    // Drop Chip Select To Start Programming The Page
+    ejtag_write(CC_FLASHCONTROL, 0);
+    spi_wait();
 }
 
 
-void sflash_poll(unsigned int addr, unsigned int data)
+int sflash_spi_detect(void)
 {
-    
-    if ((cmd_type == CMD_TYPE_BSC) || (cmd_type == CMD_TYPE_SCS))
-    {
-       // Wait Until Ready
-       while ( (ejtag_read_h(FLASH_MEMORY_START) & STATUS_READY) != STATUS_READY );
-    }
-    else
-    {
-       // Wait Until Ready
-       while ( (ejtag_read_h(addr) & STATUS_READY) != (data & STATUS_READY) );
-    }
+    unsigned int part = (cpu_chip_id >> 12) & 0xFFFF;
+    unsigned int sbidhigh;
 
-}
+    // Only Broadcom Sonics Chips Have Chipcommon At 0x18000000
+    if (!issue_spi || flash_x32)  return 0;
+    if ((cpu_chip_id & 0xFFF) != 0x17F)  return 0;
+    if (((part & 0xFF00) != 0x4700) && ((part & 0xFF00) != 0x5300))  return 0;
 
+    if ((ejtag_read(CC_CAPABILITIES) & CC_CAP_FLASH_MASK) != CC_CAP_SFLASH_ST)  return 0;
 
-void sflash_erase_area(unsigned int start, unsigned int length)
-{
-    int cur_block;
-    int tot_blocks;
-    unsigned int reg_start;
-    unsigned int reg_end;
+    sbidhigh    = ejtag_read(CC_SBIDHIGH);
+    cc_revision = (sbidhigh & 0xF) | ((sbidhigh & 0x7000) >> 8);
+    return 1;
+}
 
 
-    reg_start = start;
-    reg_end   = reg_start + length;
+void sflash_spi_unprotect(void)
+{
+    unsigned int status;
+
+    // Protected Blocks Silently Ignore Erase & Program - Clear Them Once After Detection
+    spi_cmd(SFLASH_ST_RDSR);
+    status = ejtag_read(CC_FLASHDATA) & 0xFF;
+    if (!(status & SFLASH_ST_BP_MASK))  return;
+
+    printf("(clearing block protection %02x) ... ", status);
+    spi_cmd((vendid == 0x00BF) ? SFLASH_ST_EWSR : SFLASH_ST_WREN);
+    ejtag_write(CC_FLASHDATA, 0);
+    spi_cmd(SFLASH_ST_WRSR);
+    spi_wait();
+}
 
-    tot_blocks = 0;
 
-    for (cur_block = 1;  cur_block <= block_total;  cur_block++)
-    {
-       block_addr = blocks[cur_block];
-       if ((block_addr >= reg_start) && (block_addr < reg_end))  tot_blocks++;
-    }
+flash_driver_type  flash_driver_list[] = {
+   { CMD_TYPE_AMD, 0x0002, "AMD",       0, amd_read_ids,   amd_reset,   amd_poll,   amd_erase_block,   amd_erase_start, amd_erase_suspend, amd_erase_busy, amd_erase_chip, amd_write_buffer, amd_unlock_bypass, FLASH_PROGRAM_TABLE(amd)   },
+   { CMD_TYPE_SST, 0x0701, "SST",       0, sst_read_ids,   amd_reset,   amd_poll,   sst_erase_block,   NULL,            NULL,              NULL,           sst_erase_chip, NULL,             NULL,              FLASH_PROGRAM_TABLE(sst)   },
+   { CMD_TYPE_BSC, 0x0003, "Intel BSC", 1, intel_read_ids, intel_reset, intel_poll, intel_erase_block, NULL,            NULL,              NULL,           bsc_erase_chip, NULL,             NULL,              FLASH_PROGRAM_TABLE(intel) },
+   { CMD_TYPE_SCS, 0x0001, "Intel SCS", 1, intel_read_ids, intel_reset, intel_poll, intel_erase_block, NULL,            NULL,              NULL,           scs_erase_chip, scs_write_buffer, NULL,              FLASH_PROGRAM_TABLE(intel) },
+   { CMD_TYPE_SPI, 0,      "Serial",    0, spi_read_ids,   spi_reset,   spi_poll,   spi_erase_block,   NULL,            NULL,              NULL,           spi_erase_chip, spi_write_buffer, NULL,              { { spi_program_le, spi_program_be }, { spi_program_le, spi_program_be } } },
+   { 0 }
+   };
 
-    printf("Total Blocks to Erase: %d\n\n", tot_blocks);
+// AMD In Unlock Bypass Mode - Only Programming Differs
+flash_driver_type  amd_bypass_driver =
+   { CMD_TYPE_AMD, 0x0002, "AMD",       0, amd_read_ids,   amd_reset,   amd_poll,   amd_erase_block,   amd_erase_start, amd_erase_suspend, amd_erase_busy, amd_erase_chip, amd_write_buffer, amd_unlock_bypass, FLASH_PROGRAM_TABLE(amd_bypass) };
 
-    for (cur_block = 1;  cur_block <= block_total;  cur_block++)
-    {
-       block_addr = blocks[cur_block];
-       if ((block_addr >= reg_start) && (block_addr < reg_end))
-          {
-             printf("Erasing block: %d (addr = %08x)...", cur_block, block_addr);  fflush(stdout);
-             sflash_erase_block(block_addr);
-             printf("Done\n");  fflush(stdout);
-          }
-    }
+// AMD Pairs On A 32 Bit Bus (/x32) - No Write Buffer, The Two Chips' Buffers Would Need Separate Counts
+flash_driver_type  amd_x32_driver =
+   { CMD_TYPE_AMD, 0x0002, "AMD x32",   0, amd_x32_read_ids, amd_x32_reset, amd_x32_poll, amd_x32_erase_block, amd_x32_erase_start, amd_x32_erase_suspend, amd_x32_erase_busy, amd_x32_erase_chip, NULL, amd_x32_unlock_bypass, FLASH_PROGRAM_TABLE_X32(amd_x32) };
 
-}
+flash_driver_type  amd_x32_bypass_driver =
+   { CMD_TYPE_AMD, 0x0002, "AMD x32",   0, amd_x32_read_ids, amd_x32_reset, amd_x32_poll, amd_x32_erase_block, amd_x32_erase_start, amd_x32_erase_suspend, amd_x32_erase_busy, amd_x32_erase_chip, NULL, amd_x32_unlock_bypass, FLASH_PROGRAM_TABLE_X32(amd_x32_bypass) };
 
 
-void sflash_erase_block(unsigned int addr)
+void sflash_select_driver(unsigned int type)
 {
+    flash_driver_type*  driver = flash_driver_list;
 
-    if (cmd_type == CMD_TYPE_AMD)
-    {
+    cmd_type     = type;
+    flash_driver = NULL;
 
-        //Unlock Block
-        ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
-        ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
-        ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00800080);
+    while (driver->cmd_type)
+    {
+       if (driver->cmd_type == type)
+       {
+          flash_driver = driver;
+          break;
+       }
+       driver++;
+    }
 
-        //Erase Block
-        ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
-        ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
-        ejtag_write_h(addr, 0x00300030);
+    // Same Commands Sent To Both Chips Of An x32 Pair
+    if (flash_x32 && (type == CMD_TYPE_AMD))  flash_driver = &amd_x32_driver;
+}
 
-        // Wait for Erase Completion
-        sflash_poll(addr, 0xFFFF);
 
-    }
+void sflash_read_ids(void)
+{
+    flash_driver->read_ids();
+}
 
-    if (cmd_type == CMD_TYPE_SST)
-    {
 
-        //Unlock Block
-        ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
-        ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
-        ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00800080);
+void sflash_reset(void)
+{
+    if (flash_driver)  flash_driver->reset();
+}
 
-        //Erase Block
-        ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
-        ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
-        ejtag_write_h(addr, 0x00500050);
 
-        // Wait for Erase Completion
-        sflash_poll(addr, 0xFFFF);
+void sflash_poll(unsigned int addr, unsigned int data)
+{
+    flash_driver->poll(addr, data);
+}
 
-    }
 
-    if ((cmd_type == CMD_TYPE_BSC) || (cmd_type == CMD_TYPE_SCS))
-    {
+void sflash_erase_block(unsigned int addr)
+{
+    // No Second Erase Until The Background One Is Done
+    if (bg_erase_block)  sflash_erase_step(1);
 
-        //Unlock Block
-        ejtag_write_h(addr, 0x00500050);     // Clear Status Command
-        ejtag_write_h(addr, 0x00600060);     // Unlock Flash Block Command
-        ejtag_write_h(addr, 0x00D000D0);     // Confirm Command
-        
-        // Wait for Unlock Completion
-        sflash_poll(addr, STATUS_READY);
+    flash_driver->erase_block(addr);
+    sflash_reset();
+}
 
-        //Erase Block
-        ejtag_write_h(addr, 0x00500050);     // Clear Status Command
-        ejtag_write_h(addr, 0x00200020);     // Block Erase Command
-        ejtag_write_h(addr, 0x00D000D0);     // Confirm Command
 
-        // Wait for Erase Completion
-        sflash_poll(addr, STATUS_READY);
+void sflash_erase_chip(void)
+{
+    double start_seconds = get_seconds();
 
-    }
+    printf("Erasing Whole Chip (%d blocks)...\n", block_total);  fflush(stdout);
 
+    flash_driver->erase_chip(start_seconds);
     sflash_reset();
 
+    printf("Done  (%d seconds)                              \n\n", (int)(get_seconds() - start_seconds));
 }
 
 
-void sflash_reset(void)
+void sflash_unlock_bypass(int enable)
 {
 
-    if ((cmd_type == CMD_TYPE_AMD) || (cmd_type == CMD_TYPE_SST))
+    if (!flash_driver->unlock_bypass || !(flash_flags & FLAG_UNLOCK_BYPASS) || !issue_bypass)  return;
+    if (flash_buffer_size)  return;   // Write Buffer programming beats it and needs the full unlock
+
+    if (enable && !unlock_bypass)
     {
-        ejtag_write_h(FLASH_MEMORY_START, 0x00F000F0);    // Set array to read mode
+        flash_driver->unlock_bypass(1);
+        unlock_bypass = 1;
+        flash_driver  = flash_x32 ? &amd_x32_bypass_driver : &amd_bypass_driver;   // Same part, shorter program sequence
     }
 
-    if ((cmd_type == CMD_TYPE_BSC) || (cmd_type == CMD_TYPE_SCS))
+    if (!enable && unlock_bypass)
     {
-        ejtag_write_h(FLASH_MEMORY_START, 0x00500050);    // Clear CSR
-        ejtag_write_h(FLASH_MEMORY_START, 0x00ff00ff);    // Set array to read mode
+        flash_driver->unlock_bypass(0);
+        unlock_bypass = 0;
+        sflash_select_driver(cmd_type);
     }
 
 }
 
 
-void sflash_write_word(unsigned int addr, unsigned int data)
+void sflash_write_buffer(unsigned int addr, unsigned int *data, unsigned int count)
 {
-unsigned int data_lo, data_hi;
-unsigned int swap;
-
-    if (USE_DMA)
-    {
-    	 // DMA Uses Byte Lanes
-       data_lo = data;
-       data_hi = data;
-    }
-    else   
-    {
-    	 // PrAcc Does Not
-       data_lo = (data & 0xFFFF);
-       data_hi = ((data >> 16) & 0xFFFF);
-
-       if (bigendian) {
-	 swap = data_lo;
-	 data_lo = data_hi;
-	 data_hi = swap;
-       }
-    }
+    sflash_erase_hold(1);
+    flash_driver->write_buffer(addr, data, count);
+}
 
-    if (cmd_type == CMD_TYPE_AMD)
-    {
-      // Handle Half Of Word
-      ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
-      ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
-      ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00A000A0);
-      ejtag_write_h(addr, data_lo);
 
-      // Wait for Completion
-      if (!bigendian) {
-	sflash_poll(addr, (data & 0xffff));
-      } else {
-	sflash_poll(addr, ((data >> 16) & 0xffff));
-      }
+void sflash_write_word(unsigned int addr, unsigned int data)
+{
+    sflash_program_words(addr, &data, 1);
+}
 
-      // Now Handle Other Half Of Word
-      ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00AA00AA);
-      ejtag_write_h(FLASH_MEMORY_START+(0x2AA << 1), 0x00550055);
-      ejtag_write_h(FLASH_MEMORY_START+(0x555 << 1), 0x00A000A0);
-      ejtag_write_h(addr+2, data_hi);
-
-      // Wait for Completion
-      if (!bigendian) {
-	sflash_poll(addr+2, ((data >> 16) & 0xffff));
-      } else {
-	sflash_poll(addr+2, (data & 0xffff));
-      }
-    }
 
-    if (cmd_type == CMD_TYPE_SST)
-    {
-      // Handle Half Of Word
-      ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
-      ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
-      ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00A000A0);
-      ejtag_write_h(addr, data_lo);
+void sflash_program_words(unsigned int addr, unsigned int *data, unsigned int count)
+{
+    sflash_erase_hold(1);
 
-      // Wait for Completion
-      if (!bigendian) {
-	sflash_poll(addr, (data & 0xffff));
-      } else {
-	sflash_poll(addr, ((data >> 16) & 0xffff));
-      }
+    // Pick The Loop Built For This Access Mode & Endianness Once, Not Per Word
+    flash_driver->program[USE_DMA ? 1 : 0][bigendian ? 1 : 0](addr, data, count);
+}
 
-      // Now Handle Other Half Of Word
-      ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00AA00AA);
-      ejtag_write_h(FLASH_MEMORY_START+(0x2AAA << 1), 0x00550055);
-      ejtag_write_h(FLASH_MEMORY_START+(0x5555 << 1), 0x00A000A0);
-      ejtag_write_h(addr+2, data_hi);
-
-      // Wait for Completion
-      if (!bigendian) {
-	sflash_poll(addr+2, ((data >> 16) & 0xffff));
-      } else {
-	sflash_poll(addr+2, (data & 0xffff));
-      }
-    }
 
-    if ((cmd_type == CMD_TYPE_BSC) || (cmd_type == CMD_TYPE_SCS))
+void option_file(char *dest, char *name, unsigned int size)
+{
+    // Names Go Into Fixed Buffers - Too Long Is An Error, Not An Overrun
+    if (strlen(name) >= size)
     {
-       // Handle Half Of Word
-       ejtag_write_h(addr, 0x00500050);     // Clear Status Command
-       ejtag_write_h(addr, 0x00400040);     // Write Command
-       ejtag_write_h(addr, data_lo);        // Send HalfWord Data
-       ejtag_write_h(addr, 0x00700070);     // Check Status Command
-
-       // Wait for Completion
-       sflash_poll(addr, STATUS_READY);
-
-       // Now Handle Other Half Of Word
-       ejtag_write_h(addr+2, 0x00500050);   // Clear Status Command
-       ejtag_write_h(addr+2, 0x00400040);   // Write Command
-       ejtag_write_h(addr+2, data_hi);      // Send HalfWord Data
-       ejtag_write_h(addr+2, 0x00700070);   // Check Status Command
-
-       // Wait for Completion
-       sflash_poll(addr+2, STATUS_READY);
+       show_usage();
+       printf("\n*** ERROR - File name '%.40s...' is too long (%d characters max) ***\n\n", name, size - 1);
+       exit(1);
     }
+    strcpy(dest, name);
 }
 
 
@@ -1642,7 +6009,12 @@ void show_usage(void)
            "            -flash:kernel128k (128k cfe)\n"
            "            -flash:wholeflash\n"
            "            -flash:custom\n"
-           "            -probeonly\n\n"
+           "            -probeonly\n"
+           "            -load:<file> (raw or ELF image into RAM, then run it)\n"
+           "            -dump (memory at /start for /length, no flash probing)\n"
+           "            -bwtest (read throughput of each access mode at /start)\n"
+           "            -benchscan (time scan vector expansion, no cable needed)\n"
+           "            -export:<file> (sparse backup to a raw one, no cable needed)\n\n"
 
            "            Optional Switches\n"
            "            -----------------\n"
@@ -1652,6 +6024,24 @@ void show_usage(void)
            "            /nobreak ........... prevent Issuing Debug Mode JTAGBRK\n"
            "            /noerase ........... prevent Forced Erase before Flashing\n"
            "            /notimestamp ....... prevent Timestamping of Backups\n"
+           "            /nobypass .......... prevent AMD Unlock Bypass Programming\n"
+           "            /nobuffer .......... prevent Write Buffer Programming\n"
+           "            /diff .............. only erase/program blocks that changed\n"
+           "            /nochiperase ....... prevent Chip Erase of a whole flash\n"
+           "            /ramaddr:XXXXXXXX .. scratch RAM for on-target helpers (in HEX)\n"
+           "            /timing ............ use chip timings to skip per-word polls\n"
+           "            /noverify .......... prevent reading back each flashed block\n"
+           "            /nospi ............. prevent looking for chipcommon serial flash\n"
+           "            /nodualbank ........ prevent erasing one bank while programming the other\n"
+           "            /x32 ............... flash is two x16 chips side by side (AMD only)\n"
+           "            /progress:FILE ..... machine readable progress lines to FILE (- = stderr)\n"
+           "            /nothreads ......... prevent formatting progress on a separate thread\n"
+           "            /resume ............ carry on an interrupted backup or flash from its journal\n"
+           "            /sparse ............ backup only non-blank blocks, packed, with block hashes\n"
+           "            /basis:FILE ........ /diff against a sparse backup instead of reading flash\n"
+           "            /image:FILE ........ -flash from FILE (raw, ELF, Intel HEX, S-record or TRX)\n"
+           "            /offsets ........... Intel HEX / S-record addresses are offsets into the area\n"
+           "            /bankreg:XXXXXXXX .. register selecting the 32MB flash bank (in HEX)\n"
            "            /dma ............... force use of DMA routines\n"
            "            /nodma ............. force use of PRACC routines (No DMA)\n"
            "            /window:XXXXXXXX ... custom flash window base (in HEX)\n"
@@ -1662,7 +6052,9 @@ void show_usage(void)
            "            /instrlen:XX ....... set instruction length manually\n"
            "            /wiggler ........... use wiggler cable\n"
 	   "            /bigendian ......... cpu is bigendian not littleendian\n"
-           "            /bigendianfile...... rw bigendian files\n\n"
+           "            /bigendianfile...... rw bigendian files\n"
+           "            /loadaddr:XXXXXXXX . RAM address for -load of a raw image (in HEX)\n"
+           "            /entry:XXXXXXXX .... start address after -load (in HEX)\n\n"
 
            "            /fc:XX = Optional (Manual) Flash Chip Selection\n"
 
@@ -1686,7 +6078,10 @@ void show_usage(void)
            "           /noreset and /nobreak command line options together.  Some bcm47xx\n"
            "           chips *may* always require both these options to function properly.\n\n"
            
-           "        4) When using this utility, usually it is best to type the command line\n"
+           "        4) For -load the SDRAM must already be set up (by a running CFE), so\n"
+           "           you usually want the /noreset option as well.\n\n"
+
+           "        5) When using this utility, usually it is best to type the command line\n"
            "           out, then plug in the router, and then hit <ENTER> quickly to avoid\n"
            "           the CPUs watchdog interfering with the EJTAG operations.\n\n"
            
@@ -1750,6 +6145,12 @@ int main(int argc, char** argv)
     if (strcasecmp(choice,"-flash:custom")==0)       { run_option = 3;  strcpy(AREA_NAME, "CUSTOM");  custom_options++; }
 
     if (strcasecmp(choice,"-probeonly")==0)          { run_option = 4;  }
+
+    if (strncasecmp(choice,"-load:",6)==0)           { run_option = 5;  option_file(image_file, (char *)choice + 6, sizeof(image_file));  }
+    if (strcasecmp(choice,"-dump")==0)               { run_option = 6;  }
+    if (strcasecmp(choice,"-bwtest")==0)             { run_option = 7;  }
+    if (strcasecmp(choice,"-benchscan")==0)          { run_option = 8;  }
+    if (strncasecmp(choice,"-export:",8)==0)         { run_option = 9;  option_file(image_file, (char *)choice + 8, sizeof(image_file));  }
     
 
     if (run_option == 0)
@@ -1772,6 +6173,34 @@ int main(int argc, char** argv)
           else if (strcasecmp(choice,"/nobreak")==0)         issue_break = 0;
           else if (strcasecmp(choice,"/noerase")==0)         issue_erase = 0;
           else if (strcasecmp(choice,"/notimestamp")==0)     issue_timestamp = 0;
+          else if (strcasecmp(choice,"/nobypass")==0)        issue_bypass = 0;
+          else if (strcasecmp(choice,"/nobuffer")==0)        issue_buffer = 0;
+          else if (strcasecmp(choice,"/diff")==0)            diff_mode = 1;
+          else if (strcasecmp(choice,"/nochiperase")==0)     issue_chiperase = 0;
+          else if (strncasecmp(choice,"/bankreg:",9)==0)     bank_register = strtoul(((char *)choice + 9),NULL,16);
+          else if (strcasecmp(choice,"/noverify")==0)        issue_verify = 0;
+          else if (strcasecmp(choice,"/nospi")==0)           issue_spi = 0;
+          else if (strcasecmp(choice,"/nodualbank")==0)      issue_dualbank = 0;
+          else if (strcasecmp(choice,"/x32")==0)             flash_x32 = 1;
+          else if (strcasecmp(choice,"/nothreads")==0)       issue_threads = 0;
+          else if (strcasecmp(choice,"/resume")==0)          issue_resume = 1;
+          else if (strcasecmp(choice,"/sparse")==0)          backup_sparse = 1;
+          else if (strcasecmp(choice,"/offsets")==0)         image_offsets = 1;
+          else if (strncasecmp(choice,"/image:",7)==0)       option_file(image_file, (char *)choice + 7, sizeof(image_file));
+          else if (strncasecmp(choice,"/basis:",7)==0)     { option_file(basis_file, (char *)choice + 7, sizeof(basis_file));  diff_mode = 1;  }
+          else if (strncasecmp(choice,"/progress:",10)==0)
+          {
+             // "-" Sends The Machine Readable Stream To stderr
+             if (strcmp(((char *)choice + 10), "-") == 0)  progress_stream = stderr;
+             else  progress_stream = fopen(((char *)choice + 10), "w");
+             if (progress_stream == NULL)
+             {
+                fprintf(stderr,"Could not open %s for progress output\n", ((char *)choice + 10));
+                exit(1);
+             }
+          }
+          else if (strcasecmp(choice,"/timing")==0)          issue_timing = 1;
+          else if (strncasecmp(choice,"/ramaddr:",9)==0)     ram_helper_addr = strtoul(((char *)choice + 9),NULL,16);
           else if (strcasecmp(choice,"/dma")==0)             force_dma = 1;
           else if (strcasecmp(choice,"/nodma")==0)           force_nodma = 1;
           else if (strncasecmp(choice,"/fc:",4)==0)          selected_fc = strtoul(((char *)choice + 4),NULL,10);
@@ -1784,6 +6213,8 @@ int main(int argc, char** argv)
           else if (strcasecmp(choice,"/wiggler")==0)         wiggler = 1;
 	  else if (strcasecmp(choice,"/bigendian")==0)       bigendian = 1;
           else if (strcasecmp(choice,"/bigendianfile")==0)   bigendianfile = 1;		   
+          else if (strncasecmp(choice,"/loadaddr:",10)==0) { selected_load   = strtoul(((char *)choice + 10),NULL,16); loadaddr_given = 1;  }
+          else if (strncasecmp(choice,"/entry:",7)==0)     { selected_entry  = strtoul(((char *)choice + 7),NULL,16);  entry_given = 1;  }
           else
           {
              show_usage();
@@ -1794,6 +6225,21 @@ int main(int argc, char** argv)
        }
     }
     
+    if ((run_option == 6) && (selected_length == 0))
+    {
+       show_usage();
+       printf("\n*** ERROR - '-dump' requires '/start' and '/length' options ***\n\n");
+       exit(1);
+    }
+
+    // Loops Run Up To start + length - It Has To Fit In 32 Bits
+    if (selected_length > (0xFFFFFFFF - selected_start))
+    {
+       show_usage();
+       printf("\n*** ERROR - '/start:%08x' plus '/length:%08x' runs past the end of memory ***\n\n", selected_start, selected_length);
+       exit(1);
+    }
+
     if (strcasecmp(AREA_NAME,"CUSTOM")==0)
     {
        if ((custom_options != 0) && (custom_options != 4))
@@ -1805,6 +6251,21 @@ int main(int argc, char** argv)
     }
 
 
+    // ----------------------------------
+    // Host Only Benchmarks (No Cable Needed)
+    // ----------------------------------
+    if (run_option == 8)
+    {
+       run_benchscan();
+       return 0;
+    }
+    if (run_option == 9)
+    {
+       run_export(image_file);
+       return 0;
+    }
+
+
     // ----------------------------------
     // Detect CPU 
     // ----------------------------------
@@ -1858,7 +6319,8 @@ int main(int argc, char** argv)
     {
        set_instr(INSTR_CONTROL);
        ctrl_reg = ReadWriteData(PRACC | PROBEN | SETDEV | JTAGBRK );
-       if (ReadWriteData(PRACC | PROBEN | SETDEV) & BRKST)  
+       debug_mode = (ReadWriteData(PRACC | PROBEN | SETDEV) & BRKST) ? 1 : 0;
+       if (debug_mode)
           printf("<Processor Entered Debug Mode!> ... ");
        else  
           printf("<Processor did NOT enter Debug Mode!> ... ");
@@ -1877,6 +6339,20 @@ int main(int argc, char** argv)
     } else printf("Skipped\n");
 
 
+    // ----------------------------------
+    // Memory Operations (No Flash Needed)
+    // ----------------------------------
+    if (run_option >= 5)
+    {
+       if (run_option == 5 )  run_load(image_file, selected_load, selected_entry);
+       if (run_option == 6 )  run_dump(selected_start, selected_length);
+       if (run_option == 7 )  run_bwtest(selected_start, selected_length ? selected_length : size64K);
+       printf("\n\n *** REQUESTED OPERATION IS COMPLETE ***\n\n");
+       chip_shutdown();
+       return 0;
+    }
+
+
     // ----------------------------------
     // Flash Chip Detection
     // ----------------------------------
@@ -1893,7 +6369,7 @@ int main(int argc, char** argv)
     {
        if (run_option == 1 )  run_backup(AREA_NAME, AREA_START, AREA_LENGTH);
        if (run_option == 2 )  run_erase(AREA_NAME, AREA_START, AREA_LENGTH);
-       if (run_option == 3 )  run_flash(AREA_NAME, AREA_START, AREA_LENGTH);
+       if (run_option == 3 )  run_flash(image_file[0] ? image_file : AREA_NAME, AREA_START, AREA_LENGTH);
        if (run_option == 4 );  // Probe was already run so nothing else needed
     }
 
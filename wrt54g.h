@@ -5,6 +5,84 @@
 //  Note:
 //  This program is for De-Bricking the WRT54G/GS routers
 //
+//  New for v4.9 - Flash status polling with PrAcc routines loops inside one
+//                 debug module (register setup once per wait); with
+//                 /ramaddr the loop runs from target RAM instead, without
+//                 it every poll still fetches ~6 instructions through PrAcc
+//               - Added "-load:<file>" to run raw or ELF images from RAM
+//                     - /loadaddr:XXXXXXXX . RAM address for raw images
+//                     - /entry:XXXXXXXX .... start address after loading
+//               - Added "-dump" to save any memory range without probing flash
+//               - Added "-bwtest" to report throughput of each access mode
+//               - Added AMD Unlock Bypass programming for chips that have it
+//                     - /nobypass .......... prevent Unlock Bypass programming
+//               - Added Write Buffer programming (Intel 28FxxxJ3, AMD MirrorBit)
+//                     - /nobuffer .......... prevent Write Buffer programming
+//               - Added Differential Flashing (skips unchanged blocks and only
+//                 erases blocks that need a bit set back to 1)
+//                     - /diff .............. only erase/program changed blocks
+//               - Erasing a whole flash uses Chip Erase (AMD/SST) or a single
+//                 unlock pass then erase (Intel) with timed progress reports
+//                     - /nochiperase ....... prevent Chip Erase
+//               - Added Multi-Sector Erase for AMD parts using a small helper
+//                 run from target RAM (queues sectors inside the 50us window)
+//                     - /ramaddr:XXXXXXXX .. scratch RAM for on-target helpers
+//               - Added typical/max program and erase times to the flash chip
+//                 table; with a slow link the per-word poll is skipped and
+//                 each block is verified and patched up instead
+//                     - /timing ............ enable the timing model
+//               - The image is analysed before flashing: 0xFFFF half words and
+//                 blank blocks are not programmed, blocks blank in the image
+//                 and already blank on flash are not erased, and the progress
+//                 percentage counts the bytes really programmed
+//               - Added CFI query support - command set, geometry, write buffer
+//                 and timings come from the chip; flash_chip_list is only needed
+//                 as an override or for parts without CFI
+//               - Block map is now a list of flash regions searched in log time;
+//                 no limit on the number of blocks, 32MB parts supported and
+//                 flash beyond the CPU window reached through a bank register
+//                     - /bankreg:XXXXXXXX .. register selecting the flash bank
+//               - Flash command sets are now drivers (flash_driver_list) with
+//                 program loops built per access mode & endianness
+//               - Each flashed block is read back right away; bad words are
+//                 programmed again, then the block is erased and retried
+//                     - /noverify .......... skip the verify pass
+//               - Added serial (SPI) flash behind the Broadcom chipcommon
+//                 controller (BCM5354 and later) - page program & sector erase
+//                     - /nospi ............. skip the serial flash check
+//               - Dual bank (read-while-write) parts erase one bank while
+//                 programming the other
+//                     - /nodualbank ........ erase everything up front instead
+//               - Interleaved x32 bus mode - both chips of a side by side
+//                 x16 pair take each command & program in one 32 bit write
+//                     - /x32 ............... two x16 chips on a 32 bit bus
+//               - Progress drawn at a fixed rate, hex dumps written in
+//                 large blocks instead of a word at a time
+//                     - /progress:FILE ..... machine readable progress stream
+//               - Image files memory mapped (backups pre-sized, flash images
+//                 read-only), endian swaps done in one pass over the buffer
+//               - Cable thread hands dumps, progress & file swaps to a
+//                 console thread through a lock-free ring (POSIX builds)
+//                     - /nothreads ......... keep everything on one thread
+//               - Scan vectors expanded to parallel port pin states by table
+//                 lookup (8 bits at a time, SSE2 where built in) and TDO packed
+//                 back 16 samples at a time instead of bit by bit
+//                     - "-benchscan" ....... time it against the per bit loop
+//               - Backups and flashes keep a journal (<file>.journal) of the
+//                 blocks erased, programmed and saved, synced once a second
+//                     - /resume ............ carry on from where it stopped
+//               - Sparse backups - chip & block map header, a hash per block,
+//                 only non-blank blocks stored (PackBits), any block readable
+//                 on its own; the hashes stand in for the flash under /diff
+//                     - /sparse ............ write <file>.SAVED_<time>.SPARSE
+//                     - /basis:FILE ........ /diff against a sparse backup
+//                     - "-export:<file>" ... write the raw backup it stands for
+//               - ELF, Intel HEX, S-record and TRX images are parsed into
+//                 segments; only blocks they touch are erased & programmed and
+//                 bytes they leave out of those blocks are kept
+//                     - /image:FILE ........ flash the area from FILE
+//                     - /offsets ........... HEX & S-record addresses count from the area
+//
 //  New for cshore2 - Added 1 new Flash Chip Parts to the list:
 //                     - MX29LV640MB 4Mx16 BotB    (8MB)
 //                  - Fixed bug in wiggler cable support
@@ -121,6 +199,11 @@
 
    #include <unistd.h>
    #include <sys/ioctl.h>
+   #include <sys/time.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <pthread.h>
+   #include <sched.h>
 
    #ifdef __FreeBSD__
       #include <dev/ppbus/ppi.h>
@@ -133,6 +216,11 @@
 
 #endif
 
+#if defined(__SSE2__)
+   #include <emmintrin.h>    // Scan kernels - 16 pin states / TDO samples at a time
+   #define SCAN_SSE2
+#endif
+
 #define true  1
 #define false 0
 
@@ -198,13 +286,83 @@
 #define  size4MB       0x400000
 #define  size8MB       0x800000
 #define  size16MB      0x1000000
+#define  size32MB      0x2000000
 
 #define  CMD_TYPE_BSC  0x01
 #define  CMD_TYPE_SCS  0x02
 #define  CMD_TYPE_AMD  0x03
 #define  CMD_TYPE_SST  0x04
+#define  CMD_TYPE_SPI  0x05
 
 #define  STATUS_READY  0x0080
+#define  X32_STATUS_READY   0x00800080   // DQ7 of both chips of an x32 pair
+#define  X32_STATUS_TOGGLE  0x00400040   // DQ6 of both chips of an x32 pair
+
+#define  FLAG_UNLOCK_BYPASS  0x0001   // AMD Unlock Bypass (20h) Programming
+#define  FLAG_DUAL_BANK      0x0002   // Read-While-Write - One Bank Erases While The Other Programs
+#define  FLAG_BANK_SPLIT(n)  (FLAG_DUAL_BANK | ((n) << 8))   // Second Bank Starts After Region n
+#define  FLAG_BANK_REGIONS(f)  (((f) >> 8) & 0xF)
+
+#define  MAX_WRITE_BUFFER    64       // Largest Write Buffer in flash_chip_list (Bytes)
+#define  PROGRAM_RUN_WORDS   16       // Words handed to a driver program loop at a time
+#define  VERIFY_RETRIES      2        // Erase & re-program attempts for a block failing verify
+#define  WRITE_BUFFER_TRIES  1000     // Write to Buffer commands issued before giving up on XSR.7
+#define  PROGRESS_INTERVAL   0.1      // Seconds between progress renders (10 Hz)
+#define  PROGRESS_TEXT_SIZE  65536    // Hex dump held back between renders (Bytes)
+#define  PROGRESS_RING_SIZE  256      // Records queued from the cable thread to the console thread
+
+#define  PROGRESS_DUMP       1        // Words transferred - count & show them
+#define  PROGRESS_SKIP       2        // Blank run left out
+#define  PROGRESS_ADVANCE    3        // Bytes done without a dump
+#define  PROGRESS_FLUSH      4        // Print everything queued so far
+#define  PROGRESS_END        5        // Final render
+#define  PROGRESS_START      6        // New operation - reset the counters
+#define  MAX_CFI_REGIONS     8        // Erase Regions kept from a CFI query
+#define  MAX_FLASH_REGIONS   16       // Regions (runs of equal blocks) in the block map
+#define  FLASH_WINDOW_SIZE   size32MB // Flash the CPU sees at once (more needs /bankreg)
+#define  SCAN_MAX_CLOCKS     64       // TCK cycles in one precomputed scan vector
+#define  SCAN_DR_TMS         (0x1ULL | (0x3ULL << 34))  // TMS per clock of a 32 bit DR scan
+#define  SCAN_BENCH_WORDS    0x40000  // 32 bit scans timed by -benchscan
+#define  JOURNAL_SYNC_INTERVAL 1.0    // Seconds between journal syncs to disk
+
+#define  JOURNAL_ERASED      1        // Block erased, nothing programmed since
+#define  JOURNAL_STARTED     2        // Programming began - contents uncertain
+#define  JOURNAL_DONE        3        // Programmed (and verified unless /noverify)
+
+#define  SPARSE_MAGIC        "DBSPARSE" // First 8 bytes of a sparse backup
+#define  SPARSE_VERSION      1
+#define  SPARSE_SWAPPED      0x0001   // Words swapped on export (/bigendianfile)
+
+#define  IMAGE_RAW           0        // Input image formats (image_format)
+#define  IMAGE_ELF           1
+#define  IMAGE_IHEX          2
+#define  IMAGE_SREC          3
+#define  IMAGE_TRX           4
+#define  MAX_SEGMENTS_SHOWN  16       // Segments of a parsed image listed before "... more"
+
+
+// Broadcom Chipcommon Serial Flash Controller
+#define  CC_CAPABILITIES     0xB8000004
+#define  CC_FLASHCONTROL     0xB8000040
+#define  CC_FLASHADDRESS     0xB8000044
+#define  CC_FLASHDATA        0xB8000048
+#define  CC_SBIDHIGH         0xB8000FFC
+#define  CC_CAP_FLASH_MASK   0x00000700
+#define  CC_CAP_SFLASH_ST    0x00000100
+
+#define  SFLASH_START        0x80000000
+#define  SFLASH_BUSY         SFLASH_START
+#define  SFLASH_ST_WREN      0x0006   // Write Enable
+#define  SFLASH_ST_RDSR      0x0105   // Read Status Register
+#define  SFLASH_ST_WRSR      0x0101   // Write Status Register
+#define  SFLASH_ST_EWSR      0x0050   // Enable Write Status Register (SST)
+#define  SFLASH_ST_PP        0x0302   // Page Program
+#define  SFLASH_ST_SE        0x02d8   // Sector Erase
+#define  SFLASH_ST_BE        0x00c7   // Bulk Erase
+#define  SFLASH_ST_RES       0x03ab   // Read Electronic Signature
+#define  SFLASH_ST_CSA       0x1000   // Keep Chip Select Asserted (chipcommon rev >= 20)
+#define  SFLASH_ST_WIP       0x01     // Write In Progress
+#define  SFLASH_ST_BP_MASK   0x3C     // Block Protect bits (SST25VF parts power up with them set)
 
 
 // EJTAG DEBUG Unit Vector on Debug Break
@@ -213,6 +371,25 @@
 // Our 'Pseudo' Virtual Memory Access Registers
 #define MIPS_VIRTUAL_ADDRESS_ACCESS         0xFF200000
 #define MIPS_VIRTUAL_DATA_ACCESS            0xFF200004
+#define MIPS_VIRTUAL_MASK_ACCESS            0xFF200008
+#define MIPS_VIRTUAL_VALUE_ACCESS           0xFF20000C
+#define MIPS_VIRTUAL_FIFO_ACCESS            0xFF200010
+
+// Debug Return Instruction (last instruction fed when leaving Debug Mode)
+#define MIPS_DERET_INSTRUCTION              0x4200001F
+
+// Seconds With No PrAcc Access Before A Debug Module Is Given Up On
+#define PRACC_TIMEOUT                       10
+
+// Smallest MIPS32 Cache Line Size (stepping by it hits every real line)
+#define MIPS_CACHE_LINE_SIZE                16
+
+// Words Moved Per Block Transfer Module Execution
+#define BLOCK_TRANSFER_WORDS                0x400
+
+// RAM Helpers - Argument List Follows The Helper Code At This Offset
+#define RAM_HELPER_LIST_OFFSET              0x100
+#define MAX_ERASE_BATCH                     16
 
 
 // --- Uhh, Just Because I Have To ---
@@ -220,6 +397,12 @@ void chip_detect(void);
 void chip_shutdown(void);
 static unsigned char clockin(int tms, int tdi);
 void define_block(unsigned int block_count, unsigned int block_size);
+int sflash_region_of_block(int block);
+int sflash_region_of_addr(unsigned int addr);
+unsigned int sflash_block_start(int block);
+unsigned int sflash_block_size(int block);
+int sflash_block_of(unsigned int addr);
+int sflash_blocks_in(unsigned int start, unsigned int end, int *first, int *last);
 static unsigned int ejtag_read(unsigned int addr);
 static unsigned int ejtag_read_h(unsigned int addr);
 void ejtag_write(unsigned int addr, unsigned int data);
@@ -232,22 +415,111 @@ static unsigned int ejtag_pracc_read(unsigned int addr);
 void ejtag_pracc_write(unsigned int addr, unsigned int data);
 static unsigned int ejtag_pracc_read_h(unsigned int addr);
 void ejtag_pracc_write_h(unsigned int addr, unsigned int data);
+static unsigned int ejtag_pracc_poll_h(unsigned int addr, unsigned int mask, unsigned int value);
+void ejtag_read_block(unsigned int addr, unsigned int *data, unsigned int count);
+void ejtag_write_block(unsigned int addr, unsigned int *data, unsigned int count);
+void ejtag_dma_read_block(unsigned int addr, unsigned int *data, unsigned int count);
+void ejtag_dma_write_block(unsigned int addr, unsigned int *data, unsigned int count);
+void ejtag_pracc_read_block(unsigned int addr, unsigned int *data, unsigned int count);
+void ejtag_pracc_write_block(unsigned int addr, unsigned int *data, unsigned int count);
+void ejtag_pracc_cache_sync(unsigned int addr, unsigned int length);
+void ejtag_pracc_resume(unsigned int pc);
+int ejtag_call_helper(unsigned int *helper, unsigned int helper_words, unsigned int *list, unsigned int list_words, unsigned int param, unsigned int *result);
+double get_seconds(void);
+void sleep_ms(unsigned int ms);
 void identify_flash_part(void);
+void sflash_setup_part(unsigned int *region_num, unsigned int *region_size, int regions);
+void sflash_cmd(unsigned int offset, unsigned int data);
+unsigned int sflash_cfi_byte(unsigned int offset);
+unsigned int sflash_cfi_word(unsigned int offset);
+int sflash_cfi_query(void);
+void sflash_read_ids(void);
+void sflash_cfi_part(void);
 void lpt_closeport(void);
 void lpt_openport(void);
 static unsigned int ReadData(void);
 static unsigned int ReadWriteData(unsigned int in_data);
+void image_swap(unsigned int *data, unsigned int words);
+unsigned int image_hash(unsigned int *data, unsigned int words);
+int journal_open(char *name, char *op, char *file, unsigned int start, unsigned int length, unsigned int hash);
+void journal_sync(int force);
+void journal_note(char *what, unsigned int addr, unsigned int end, int sync);
+void journal_erased(int first_block, int last_block);
+int journal_block_done(unsigned int addr);
+void journal_apply(unsigned int *image, unsigned int start, unsigned int length);
+void journal_close(int complete);
+unsigned int packbits_encode(unsigned char *in, unsigned int len, unsigned char *out);
+unsigned int packbits_decode(unsigned char *in, unsigned int stored, unsigned char *out, unsigned int len);
+unsigned int sparse_save(char *filename, unsigned int *image, unsigned int start, unsigned int length);
+int sparse_load(char *filename);
+int sparse_basis(char *filename);
+void sparse_close(void);
+void run_export(char *filename);
+int image_format(char *filename);
+void image_put(unsigned int addr, unsigned char *data, unsigned int len);
+unsigned int* image_parse(char *filename, int format, unsigned int start, unsigned int length);
+int image_fill_gaps(unsigned int start, unsigned int length);
+int image_next_run(unsigned int start, unsigned int length, unsigned int *run_start, unsigned int *run_end);
+void sflash_flash_area(char *filename, unsigned int *image, unsigned int start, unsigned int length);
 void run_backup(char *filename, unsigned int start, unsigned int length);
 void run_erase(char *filename, unsigned int start, unsigned int length);
 void run_flash(char *filename, unsigned int start, unsigned int length);
+void run_load(char *filename, unsigned int load_addr, unsigned int entry);
+void run_dump(unsigned int start, unsigned int length);
+void run_bwtest(unsigned int start, unsigned int length);
+void run_benchscan(void);
+void scan_setup(void);
+void scan_expand(unsigned char *pins, unsigned long long tdi, unsigned long long tms, int clocks);
+unsigned int scan_pack(unsigned char *status, int bits);
+static void scan_clock(unsigned char *pins, unsigned char *status, int clocks);
+void load_segment(unsigned char *image, unsigned int addr, unsigned int filesz, unsigned int memsz, int big);
+unsigned int image_word(unsigned char *p, int big);
+unsigned int image_half(unsigned char *p, int big);
 void set_instr(int instr);
 void sflash_config(void);
 void sflash_erase_area(unsigned int start, unsigned int length);
+void sflash_diff_area(unsigned int *image, unsigned int start, unsigned int length);
+int sflash_program_range(unsigned int start, unsigned int *data, unsigned int words);
+int image_blank(unsigned int *data, unsigned int words);
+unsigned int image_work(unsigned int *data, unsigned int words);
+void sflash_plan_area(unsigned int *image, unsigned int start, unsigned int length);
+int progress_percent(void);
+void progress_start(char *action, unsigned int total, int by_work);
+void progress_flush(void);
+void progress_put(char *text);
+void progress_render(int force);
+void progress_end(void);
+void progress_skip(unsigned int addr, unsigned int end);
+void progress_advance(unsigned int bytes);
+void show_progress(char *action, unsigned int addr, unsigned int *data, unsigned int count);
 void sflash_erase_block(unsigned int addr);
+void sflash_erase_chip(void);
+int sflash_erase_batch(unsigned int *addrs, int count);
+void sflash_wait_progress(unsigned int addr, unsigned int ready, double start_seconds);
+void sflash_poll(unsigned int addr, unsigned int data);
+void sflash_wait(unsigned int addr, unsigned int ready);
+void sflash_poll_word(unsigned int addr, unsigned int data);
+void sflash_poll_pending(void);
+void sflash_timing_model(void);
+unsigned int sflash_block_end(unsigned int addr, unsigned int end);
+int sflash_verify_range(unsigned int addr, unsigned int *data, unsigned int words, int *fixed);
+int sflash_check_block(unsigned int addr, unsigned int *data, unsigned int words, int *fixed);
+int sflash_retry_block(unsigned int addr, unsigned int *data, unsigned int words);
 void sflash_probe(void);
 void sflash_reset(void);
+void sflash_unlock_bypass(int enable);
 void sflash_write_word(unsigned int addr, unsigned int data);
+void sflash_program_words(unsigned int addr, unsigned int *data, unsigned int count);
+void sflash_select_driver(unsigned int type);
+int sflash_spi_detect(void);
+void sflash_spi_unprotect(void);
+int sflash_dual_bank_ready(unsigned int start, unsigned int length);
+void sflash_dual_bank_area(unsigned int *image, unsigned int start, unsigned int length);
+int sflash_erase_step(int wait);
+void sflash_erase_hold(int hold);
+void sflash_write_buffer(unsigned int addr, unsigned int *data, unsigned int count);
 void show_usage(void);
+void option_file(char *dest, char *name, unsigned int size);
 void ShowData(unsigned int value);
 void test_reset(void);
 void WriteData(unsigned int in_data);
@@ -351,6 +623,295 @@ unsigned int pracc_writehalf_code_module[] = {
   0x00000000}; // nop
 
 
+unsigned int pracc_pollhalf_code_module[] = {
+               // #
+               // # HairyDairyMaid's Assembler PrAcc Poll HalfWord Routine
+               // #
+               // start:
+               // 
+               // # Load R1 with the address of the pseudo-address register
+  0x3C01FF20,  // lui $1,  0xFF20
+  0x34210000,  // ori $1,  0x0000
+               // 
+               // # Load R2 with the address to poll
+  0x8C220000,  // lw $2,  ($1)
+               // 
+               // # Load R3 with the mask from pseudo-mask register
+  0x8C230008,  // lw $3, 8($1)
+               // 
+               // # Load R4 with the expected value from pseudo-value register
+  0x8C24000C,  // lw $4, 12($1)
+               // 
+               // # Load R6 with the timeout (number of polls)
+  0x34060100,  // ori $6, $0, 0x0100
+               // 
+               // poll:
+               // 
+               // # Load R5 with the masked half word @R2
+  0x94450000,  // lhu $5, 0($2)
+  0x00A32824,  // and $5, $5, $3
+               // 
+               // # Done on a match, otherwise count down and poll again
+  0x10A40003,  // beq $5, $4, done
+  0x24C6FFFF,  // addiu $6, $6, -1
+  0x14C0FFFB,  // bne $6, $0, poll
+  0x00000000,  // nop
+               // 
+               // done:
+               // 
+               // # Store the last masked value into the pseudo-data register
+  0xAC250004,  // sw $5, 4($1)
+               // 
+  0x00000000,  // nop
+  0x1000FFF1,  // beq $0, $0, start
+  0x00000000}; // nop
+
+
+unsigned int pracc_readblock_code_module[] = {
+               // #
+               // # HairyDairyMaid's Assembler PrAcc Read Block Routine
+               // #
+               // start:
+               // 
+               // # Load R1 with the address of the pseudo-address register
+  0x3C01FF20,  // lui $1,  0xFF20
+  0x34210000,  // ori $1,  0x0000
+               // 
+               // # Load R2 with the address for the read
+  0x8C220000,  // lw $2,  ($1)
+               // 
+               // # Load R4 with the word count from pseudo-value register
+  0x8C24000C,  // lw $4, 12($1)
+               // 
+               // loop:
+               // 
+               // # Load R3 with the word @R2
+  0x8C430000,  // lw $3,  ($2)
+               // 
+               // # Push the value into the pseudo-fifo register
+  0xAC230010,  // sw $3, 16($1)
+               // 
+               // # Next word until the count runs out
+  0x2484FFFF,  // addiu $4, $4, -1
+  0x1480FFFC,  // bne $4, $0, loop
+  0x24420004,  // addiu $2, $2, 4
+               // 
+  0x00000000,  // nop
+  0x1000FFF5,  // beq $0, $0, start
+  0x00000000}; // nop
+
+
+unsigned int pracc_writeblock_code_module[] = {
+               // #
+               // # HairyDairyMaid's Assembler PrAcc Write Block Routine
+               // #
+               // start:
+               // 
+               // # Load R1 with the address of the pseudo-address register
+  0x3C01FF20,  // lui $1,  0xFF20
+  0x34210000,  // ori $1,  0x0000
+               // 
+               // # Load R2 with the address for the write
+  0x8C220000,  // lw $2,  ($1)
+               // 
+               // # Load R4 with the word count from pseudo-value register
+  0x8C24000C,  // lw $4, 12($1)
+               // 
+               // loop:
+               // 
+               // # Pop R3 from the pseudo-fifo register
+  0x8C230010,  // lw $3, 16($1)
+               // 
+               // # Store the word at @R2 (the address)
+  0xAC430000,  // sw $3,  ($2)
+               // 
+               // # Next word until the count runs out
+  0x2484FFFF,  // addiu $4, $4, -1
+  0x1480FFFC,  // bne $4, $0, loop
+  0x24420004,  // addiu $2, $2, 4
+               // 
+  0x00000000,  // nop
+  0x1000FFF5,  // beq $0, $0, start
+  0x00000000}; // nop
+
+
+unsigned int pracc_cachesync_code_module[] = {
+               // #
+               // # HairyDairyMaid's Assembler PrAcc Cache Sync Routine
+               // #
+               // start:
+               // 
+               // # Load R1 with the address of the pseudo-address register
+  0x3C01FF20,  // lui $1,  0xFF20
+  0x34210000,  // ori $1,  0x0000
+               // 
+               // # Load R2 with the first (KSEG0) line address
+  0x8C220000,  // lw $2,  ($1)
+               // 
+               // # Load R4 with the line count from pseudo-value register
+  0x8C24000C,  // lw $4, 12($1)
+               // 
+               // loop:
+               // 
+               // # Invalidate (no writeback) the D-Cache line, Invalidate the I-Cache line
+               // # - the code went in uncached, a dirty line must not be written over it
+  0xBC510000,  // cache 0x11, ($2)
+  0xBC500000,  // cache 0x10, ($2)
+               // 
+               // # Next line until the count runs out
+  0x2484FFFF,  // addiu $4, $4, -1
+  0x1480FFFC,  // bne $4, $0, loop
+  0x24420010,  // addiu $2, $2, 16
+               // 
+  0x0000000F,  // sync
+  0x00000000,  // nop
+  0x1000FFF4,  // beq $0, $0, start
+  0x00000000}; // nop
+
+
+unsigned int pracc_resume_code_module[] = {
+               // #
+               // # HairyDairyMaid's Assembler PrAcc Resume Routine
+               // #
+               // start:
+               // 
+               // # Load R1 with the address of the pseudo-address register
+  0x3C01FF20,  // lui $1,  0xFF20
+  0x34210000,  // ori $1,  0x0000
+               // 
+               // # Load R2 with the address to resume at
+  0x8C220000,  // lw $2,  ($1)
+               // 
+               // # Set the Debug Exception PC (DEPC) to it
+  0x4082C000,  // mtc0 $2, $24
+  0x00000000,  // nop
+  0x00000000,  // nop
+               // 
+               // # Leave Debug Mode
+  0x4200001F,  // deret
+  0x00000000}; // nop
+
+
+unsigned int pracc_callhelper_code_module[] = {
+               // #
+               // # HairyDairyMaid's Assembler PrAcc Call Helper Routine
+               // #
+               // start:
+               // 
+               // # Load R1 with the address of the pseudo-address register
+  0x3C01FF20,  // lui $1,  0xFF20
+  0x34210000,  // ori $1,  0x0000
+               // 
+               // # Load R2 with the (RAM) address of the helper
+  0x8C220000,  // lw $2,  ($1)
+               // 
+               // # Load R5 with the parameter from pseudo-mask register
+  0x8C250008,  // lw $5, 8($1)
+               // 
+               // # Load R4 with the count from pseudo-value register
+  0x8C24000C,  // lw $4, 12($1)
+               // 
+               // # Run the helper (it jumps back to the debug vector when done)
+  0x00400008,  // jr $2
+  0x00000000}; // nop
+
+
+unsigned int amd_multierase_ram_helper[] = {
+               // #
+               // # AMD Multi-Sector Erase Helper (runs from RAM)
+               // # R1 = pseudo registers, R2 = helper, R4 = count, R5 = flash base
+               // #
+               // start:
+               // 
+               // # Load R3 with the sector list that follows the helper
+  0x24430100,  // addiu $3, $2, 0x100
+               // 
+               // # Unlock / Erase Setup / Unlock
+  0x340600AA,  // ori $6, $0, 0x00AA
+  0xA4A60AAA,  // sh $6, 0xAAA($5)
+  0x34060055,  // ori $6, $0, 0x0055
+  0xA4A60554,  // sh $6, 0x554($5)
+  0x34060080,  // ori $6, $0, 0x0080
+  0xA4A60AAA,  // sh $6, 0xAAA($5)
+  0x340600AA,  // ori $6, $0, 0x00AA
+  0xA4A60AAA,  // sh $6, 0xAAA($5)
+  0x34060055,  // ori $6, $0, 0x0055
+  0xA4A60554,  // sh $6, 0x554($5)
+               // 
+               // # First Sector Erase Command
+  0x34060030,  // ori $6, $0, 0x0030
+  0x8C670000,  // lw $7,  ($3)
+  0xA4E60000,  // sh $6,  ($7)
+  0x2484FFFF,  // addiu $4, $4, -1
+  0x10800009,  // beq $4, $0, done
+  0x24630004,  // addiu $3, $3, 4
+               // 
+               // loop:
+               // 
+               // # Stop if DQ3 says the sector erase timeout already ran out
+  0x94E80000,  // lhu $8,  ($7)
+  0x31080008,  // andi $8, $8, 0x0008
+  0x15000005,  // bne $8, $0, done
+               // 
+               // # Queue the next Sector Erase Command
+  0x8C670000,  // lw $7,  ($3)
+  0xA4E60000,  // sh $6,  ($7)
+  0x2484FFFF,  // addiu $4, $4, -1
+  0x1480FFF9,  // bne $4, $0, loop
+  0x24630004,  // addiu $3, $3, 4
+               // 
+               // done:
+               // 
+               // # Store the number of sectors NOT queued into the pseudo-data register
+  0xAC240004,  // sw $4, 4($1)
+               // 
+               // # Back to the debug vector
+  0x3C09FF20,  // lui $9,  0xFF20
+  0x35290200,  // ori $9,  0x0200
+  0x01200008,  // jr $9
+  0x00000000}; // nop
+
+
+unsigned int pollhalf_ram_helper[] = {
+               // #
+               // # Poll HalfWord Helper (runs from RAM)
+               // # R1 = pseudo registers, R2 = helper, list = address, mask, value
+               // #
+               // start:
+               // 
+               // # Load R6/R7/R8 with the address, mask & value that follow the helper
+  0x24430100,  // addiu $3, $2, 0x100
+  0x8C660000,  // lw $6,  ($3)
+  0x8C670004,  // lw $7, 4($3)
+  0x8C680008,  // lw $8, 8($3)
+               // 
+               // # Load R9 with the timeout (number of polls)
+  0x3C090010,  // lui $9,  0x0010
+               // 
+               // poll:
+               // 
+               // # Load R10 with the masked half word @R6
+  0x94CA0000,  // lhu $10, ($6)
+  0x01475024,  // and $10, $10, $7
+               // 
+               // # Done on a match, otherwise count down and poll again
+  0x11480003,  // beq $10, $8, done
+  0x2529FFFF,  // addiu $9, $9, -1
+  0x1520FFFB,  // bne $9, $0, poll
+  0x00000000,  // nop
+               // 
+               // done:
+               // 
+               // # Store the last masked value into the pseudo-data register
+  0xAC2A0004,  // sw $10, 4($1)
+               // 
+               // # Back to the debug vector
+  0x3C09FF20,  // lui $9,  0xFF20
+  0x35290200,  // ori $9,  0x0200
+  0x01200008,  // jr $9
+  0x00000000}; // nop
+
+
 // **************************************************************************
 // End of File
 // **************************************************************************